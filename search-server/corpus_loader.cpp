@@ -0,0 +1,270 @@
+#include "corpus_loader.h"
+#include "bounded_queue.h"
+#include "mapped_file.h"
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+struct ParsedDocument : CorpusDocument {
+	vector<string_view> words;
+};
+
+using DocumentBatch = vector<ParsedDocument>;
+
+struct ChunkBatch {
+	size_t chunk = 0;
+	DocumentBatch documents;
+};
+
+vector<string_view> SplitIntoChunks(string_view data, size_t chunk_size) {
+	vector<string_view> chunks;
+	while (!data.empty()) {
+		size_t chunk_end = min(chunk_size, data.size());
+		if (chunk_end < data.size()) {
+			const size_t line_end = data.find('\n', chunk_end);
+			chunk_end = line_end == data.npos ? data.size() : line_end + 1;
+		}
+		chunks.push_back(data.substr(0, chunk_end));
+		data.remove_prefix(chunk_end);
+	}
+	return chunks;
+}
+
+string_view NextField(string_view& line, char separator) {
+	const size_t pos = line.find(separator);
+	const string_view field = line.substr(0, pos);
+	line.remove_prefix(pos == line.npos ? line.size() : pos + 1);
+	return field;
+}
+
+optional<int> ParseInt(string_view text) {
+	int value = 0;
+	const auto [ptr, error] = from_chars(text.data(), text.data() + text.size(), value);
+	if (error != errc() || ptr != text.data() + text.size()) {
+		return nullopt;
+	}
+	return value;
+}
+
+optional<DocumentStatus> ParseStatus(string_view text) {
+	if (text == "ACTUAL"sv) {
+		return DocumentStatus::ACTUAL;
+	}
+	if (text == "IRRELEVANT"sv) {
+		return DocumentStatus::IRRELEVANT;
+	}
+	if (text == "BANNED"sv) {
+		return DocumentStatus::BANNED;
+	}
+	if (text == "REMOVED"sv) {
+		return DocumentStatus::REMOVED;
+	}
+	return nullopt;
+}
+
+string_view GetStatusName(DocumentStatus status) {
+	switch (status) {
+	case DocumentStatus::ACTUAL:
+		return "ACTUAL"sv;
+	case DocumentStatus::IRRELEVANT:
+		return "IRRELEVANT"sv;
+	case DocumentStatus::BANNED:
+		return "BANNED"sv;
+	default:
+		return "REMOVED"sv;
+	}
+}
+
+// split_words(text) разбивает текст на слова так же, как SearchServer::AddDocument
+template <typename WordSplitter>
+DocumentBatch ParseChunk(WordSplitter split_words, string_view chunk, atomic<size_t>& skipped_line_count) {
+	DocumentBatch batch;
+	while (!chunk.empty()) {
+		string_view line = NextField(chunk, '\n');
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		if (line.empty()) {
+			continue;
+		}
+		auto corpus_document = ParseCorpusLine(line);
+		if (!corpus_document) {
+			++skipped_line_count;
+			continue;
+		}
+		ParsedDocument document{ move(*corpus_document), {} };
+		try {
+			document.words = split_words(document.text);
+		}
+		catch (const invalid_argument&) {
+			++skipped_line_count;
+			continue;
+		}
+		batch.push_back(move(document));
+	}
+	return batch;
+}
+
+}  // namespace
+
+optional<CorpusDocument> ParseCorpusLine(string_view line) {
+	if (line.find('\t') == line.npos) {
+		return nullopt;
+	}
+	CorpusDocument document;
+	const auto id = ParseInt(NextField(line, '\t'));
+	const auto status = ParseStatus(NextField(line, '\t'));
+	if (!id || !status || line.empty()) {
+		return nullopt;
+	}
+	document.id = *id;
+	document.status = *status;
+
+	string_view ratings = NextField(line, '\t');
+	while (!ratings.empty()) {
+		const string_view rating_text = NextField(ratings, ' ');
+		if (rating_text.empty()) {
+			continue;
+		}
+		const auto rating = ParseInt(rating_text);
+		if (!rating) {
+			return nullopt;
+		}
+		document.ratings.push_back(*rating);
+	}
+	document.text = line;
+	return document;
+}
+
+double CorpusLoadStats::GetMegabytesPerSecond() const {
+	return seconds > 0 ? byte_count / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+ostream& operator << (ostream& output, const CorpusLoadStats& stats) {
+    output << "{ "s
+        << "documents = "s << stats.document_count << ", "s
+        << "skipped_lines = "s << stats.skipped_line_count << ", "s
+        << "bytes = "s << stats.byte_count << ", "s
+        << "seconds = "s << stats.seconds << ", "s
+        << "MB/s = "s << stats.GetMegabytesPerSecond() << " }"s;
+    return output;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const string& path, size_t worker_count) {
+	const auto start_time = chrono::steady_clock::now();
+	// Тексты документов не копируются: сервер хранит string_view на файл и держит его открытым
+	const auto file = make_shared<const MappedFile>(path);
+	const auto chunks = SplitIntoChunks(file->GetData(), CORPUS_CHUNK_SIZE);
+	search_server.corpus_files_.push_back(file);
+
+	worker_count = max<size_t>(1, min(worker_count, chunks.size()));
+	// Куски разбираются в любом порядке, а индексируются по порядку номеров.
+	// Разборщик не берёт кусок дальше окна от очередного, поэтому обогнавших кусков немного
+	const size_t window_size = worker_count * 2;
+	BoundedQueue<ChunkBatch> batches(window_size);
+	mutex window_mutex;
+	condition_variable window_moved;
+	size_t indexed_chunks = 0;
+	bool stopped = false;
+	atomic<size_t> next_chunk = 0;
+	atomic<size_t> active_workers = worker_count;
+	atomic<size_t> skipped_line_count = 0;
+
+	// Разбиение на слова только читает стоп-слова, поэтому идёт в потоках-разборщиках
+	const SearchServer& reader = search_server;
+	const auto split_words = [&reader](string_view text) {
+		return reader.SplitIntoWordsNoStop(text);
+	};
+	vector<thread> workers;
+	workers.reserve(worker_count);
+	for (size_t i = 0; i < worker_count; ++i) {
+		workers.emplace_back([&] {
+			for (size_t chunk = next_chunk++; chunk < chunks.size(); chunk = next_chunk++) {
+				{
+					unique_lock lock(window_mutex);
+					window_moved.wait(lock, [&] {
+						return stopped || chunk < indexed_chunks + window_size;
+						});
+					if (stopped) {
+						break;
+					}
+				}
+				if (!batches.Push({ chunk, ParseChunk(split_words, chunks[chunk], skipped_line_count) })) {
+					break;
+				}
+			}
+			if (--active_workers == 0) {
+				batches.Close();
+			}
+			});
+	}
+	const auto stop_workers = [&] {
+		{
+			lock_guard lock(window_mutex);
+			stopped = true;
+		}
+		window_moved.notify_all();
+		batches.Close();
+		for (thread& worker : workers) {
+			worker.join();
+		}
+	};
+
+	CorpusLoadStats stats;
+	try {
+		// Куски, обогнавшие очередной, ждут своей очереди
+		map<size_t, DocumentBatch> pending;
+		while (auto batch = batches.Pop()) {
+			pending.emplace(batch->chunk, move(batch->documents));
+			for (auto ready = pending.begin(); ready != pending.end() && ready->first == indexed_chunks; ready = pending.erase(ready)) {
+				// Документы добавляются в порядке строк файла: из строк с одним id остаётся первая
+				for (const ParsedDocument& document : ready->second) {
+					try {
+						search_server.AddDocument(document.id, document.text, document.status, document.ratings, document.words, true);
+						++stats.document_count;
+					}
+					catch (const invalid_argument&) {
+						++skipped_line_count;
+					}
+				}
+				{
+					lock_guard lock(window_mutex);
+					++indexed_chunks;
+				}
+				window_moved.notify_all();
+			}
+		}
+	}
+	catch (...) {
+		stop_workers();
+		throw;
+	}
+	stop_workers();
+	if (stats.document_count == 0) {
+		search_server.corpus_files_.pop_back();
+	}
+
+	stats.skipped_line_count = skipped_line_count;
+	stats.byte_count = file->GetData().size();
+	stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+	return stats;
+}
+
+void SaveCorpus(const SearchServer& search_server, ostream& output) {
+	for (const int document_id : search_server) {
+		output << document_id << '\t' << GetStatusName(search_server.GetDocumentStatus(document_id)) << '\t'
+			<< search_server.GetDocumentRating(document_id) << '\t' << search_server.GetDocumentText(document_id) << '\n';
+	}
+}
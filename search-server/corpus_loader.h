@@ -0,0 +1,50 @@
+#pragma once
+#include "search_server.h"
+
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Размер куска файла, который разбирает один поток конвейера
+const size_t CORPUS_CHUNK_SIZE = 1 << 20;
+
+struct CorpusLoadStats {
+    size_t document_count = 0;
+    size_t skipped_line_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0.0;
+
+    double GetMegabytesPerSecond() const;
+};
+
+std::ostream& operator << (std::ostream& output, const CorpusLoadStats& stats);
+
+// Документ строки корпуса; text указывает в разобранную строку
+struct CorpusDocument {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// Разбирает строку корпуса без перевода строки. nullopt, если строка некорректна
+std::optional<CorpusDocument> ParseCorpusLine(std::string_view line);
+
+// Загружает корпус из файла: по документу на строку, поля разделены табуляцией -
+// id, статус (ACTUAL, IRRELEVANT, BANNED или REMOVED), рейтинги через пробел, текст.
+// Файл отображается в память и режется на куски. Потоки-разборщики разбирают
+// и токенизируют куски без копирования текста, а текущий поток добавляет
+// готовые документы в индекс в порядке строк файла. Между стадиями стоит
+// очередь ограниченной ёмкости.
+// Тексты документов не копируются: сервер держит файл отображённым, пока жив,
+// поэтому файл нельзя менять на месте (подменять через rename можно).
+// Некорректные строки и документы с занятыми id пропускаются, из строк
+// с одинаковым id остаётся первая.
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path,
+    size_t worker_count = CONCURRENT_THREADS);
+
+// Сохраняет живые документы в формате LoadCorpus по возрастанию id. Вместо
+// рейтингов пишется их среднее: при загрузке оно даёт тот же рейтинг документа
+void SaveCorpus(const SearchServer& search_server, std::ostream& output);
@@ -0,0 +1,68 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+
+using namespace std;
+
+DocumentBitmap::DocumentBitmap(uint32_t size)
+	: blocks_((size + 63) / 64) {
+}
+
+DocumentBitmap::DocumentBitmap(MemoryCounter* counter)
+	: blocks_(CountingAllocator<uint64_t>(counter)) {
+}
+
+void DocumentBitmap::Clear(uint32_t size) {
+	blocks_.assign((size + 63) / 64, 0);
+}
+
+void DocumentBitmap::Set(uint32_t ordinal) {
+	const size_t block = ordinal / 64;
+	if (block >= blocks_.size()) {
+		blocks_.resize(block + 1);
+	}
+	blocks_[block] |= uint64_t{ 1 } << (ordinal % 64);
+}
+
+void DocumentBitmap::Reset(uint32_t ordinal) {
+	const size_t block = ordinal / 64;
+	if (block < blocks_.size()) {
+		blocks_[block] &= ~(uint64_t{ 1 } << (ordinal % 64));
+	}
+}
+
+size_t DocumentBitmap::Count() const {
+	size_t count = 0;
+	for (const uint64_t block : blocks_) {
+		count += CountBits(block);
+	}
+	return count;
+}
+
+void DocumentBitmap::Renumber(const vector<uint32_t>& new_ordinals) {
+	decltype(blocks_) blocks((new_ordinals.back() + 63) / 64, 0, blocks_.get_allocator());
+	ForEach([&](uint32_t ordinal) {
+		const uint32_t new_ordinal = new_ordinals[ordinal];
+		blocks[new_ordinal / 64] |= uint64_t{ 1 } << (new_ordinal % 64);
+		});
+	blocks_ = move(blocks);
+}
+
+DocumentBitmap& DocumentBitmap::operator|=(const DocumentBitmap& other) {
+	if (blocks_.size() < other.blocks_.size()) {
+		blocks_.resize(other.blocks_.size());
+	}
+	for (size_t i = 0; i < other.blocks_.size(); ++i) {
+		blocks_[i] |= other.blocks_[i];
+	}
+	return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator&=(const DocumentBitmap& other) {
+	const size_t common = min(blocks_.size(), other.blocks_.size());
+	for (size_t i = 0; i < common; ++i) {
+		blocks_[i] &= other.blocks_[i];
+	}
+	fill(blocks_.begin() + common, blocks_.end(), 0);
+	return *this;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "memory_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Битовое множество внутренних номеров документов.
+// Пустые 64-битные блоки пропускаются при обходе целиком.
+class DocumentBitmap {
+public:
+    DocumentBitmap() = default;
+    explicit DocumentBitmap(uint32_t size);
+    explicit DocumentBitmap(MemoryCounter* counter);
+
+    // Пустое множество на size номеров; выделенная память сохраняется
+    void Clear(uint32_t size);
+
+    void Set(uint32_t ordinal);
+    void Reset(uint32_t ordinal);
+    bool Test(uint32_t ordinal) const {
+        const size_t block = ordinal / 64;
+        return block < blocks_.size() && (blocks_[block] >> (ordinal % 64)) & 1;
+    }
+
+    size_t Count() const;
+    // Переносит номера по new_ordinals из DocumentIdTable::Renumber.
+    // В множестве должны быть только живые документы
+    void Renumber(const std::vector<uint32_t>& new_ordinals);
+
+    DocumentBitmap& operator|=(const DocumentBitmap& other);
+    DocumentBitmap& operator&=(const DocumentBitmap& other);
+
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    std::vector<uint64_t, CountingAllocator<uint64_t>> blocks_;
+
+    static int CountTrailingZeros(uint64_t block);
+    static int CountBits(uint64_t block);
+};
+
+inline int DocumentBitmap::CountTrailingZeros(uint64_t block) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, block);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(block);
+#endif
+}
+
+inline int DocumentBitmap::CountBits(uint64_t block) {
+#if defined(_MSC_VER)
+    return static_cast<int>(__popcnt64(block));
+#else
+    return __builtin_popcountll(block);
+#endif
+}
+
+template <typename Function>
+void DocumentBitmap::ForEach(Function function) const {
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        for (uint64_t block = blocks_[i]; block != 0; block &= block - 1) {
+            function(static_cast<uint32_t>(i * 64 + CountTrailingZeros(block)));
+        }
+    }
+}
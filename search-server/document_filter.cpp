@@ -0,0 +1,56 @@
+#include "document_filter.h"
+
+#include <algorithm>
+
+using namespace std;
+
+DocumentFilter::DocumentFilter(DocumentStatus status) {
+	AddStatus(status);
+}
+
+DocumentFilter& DocumentFilter::AddStatus(DocumentStatus status) {
+	status_mask_ |= 1u << static_cast<int>(status);
+	return *this;
+}
+
+DocumentFilter& DocumentFilter::SetRatingRange(int min_rating, int max_rating) {
+	min_rating_ = min_rating;
+	max_rating_ = max_rating;
+	return *this;
+}
+
+DocumentFilter& DocumentFilter::SetIds(vector<int> document_ids) {
+	sort(document_ids.begin(), document_ids.end());
+	document_ids.erase(unique(document_ids.begin(), document_ids.end()), document_ids.end());
+	ids_ = move(document_ids);
+	has_ids_ = true;
+	return *this;
+}
+
+bool DocumentFilter::AcceptsStatus(DocumentStatus status) const {
+	return status_mask_ == 0 || (status_mask_ >> static_cast<int>(status)) & 1;
+}
+
+bool DocumentFilter::AcceptsRating(int rating) const {
+	return min_rating_ <= rating && rating <= max_rating_;
+}
+
+bool DocumentFilter::AcceptsId(int document_id) const {
+	return !has_ids_ || binary_search(ids_.begin(), ids_.end(), document_id);
+}
+
+bool DocumentFilter::HasRatingRange() const {
+	return min_rating_ != INT_MIN || max_rating_ != INT_MAX;
+}
+
+bool DocumentFilter::HasIds() const {
+	return has_ids_;
+}
+
+const vector<int>& DocumentFilter::GetIds() const {
+	return ids_;
+}
+
+bool DocumentFilter::operator()(int document_id, DocumentStatus status, int rating) const {
+	return AcceptsStatus(status) && AcceptsRating(rating) && AcceptsId(document_id);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "document.h"
+
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+const int DOCUMENT_STATUS_COUNT = 4;
+
+// Структурированный фильтр документов: множество статусов, диапазон рейтинга
+// и множество id. В отличие от произвольного предиката, сервер может заранее
+// скомпилировать его в битовую карту документов.
+// Фильтр по умолчанию пропускает все документы.
+class DocumentFilter {
+public:
+    DocumentFilter() = default;
+    explicit DocumentFilter(DocumentStatus status);
+
+    DocumentFilter& AddStatus(DocumentStatus status);
+    DocumentFilter& SetRatingRange(int min_rating, int max_rating);
+    DocumentFilter& SetIds(std::vector<int> document_ids);
+
+    bool AcceptsStatus(DocumentStatus status) const;
+    bool AcceptsRating(int rating) const;
+    bool AcceptsId(int document_id) const;
+
+    bool HasRatingRange() const;
+    bool HasIds() const;
+    const std::vector<int>& GetIds() const;
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const;
+
+private:
+    // Нулевая маска означает "любой статус"
+    uint32_t status_mask_ = 0;
+    int min_rating_ = INT_MIN;
+    int max_rating_ = INT_MAX;
+    bool has_ids_ = false;
+    std::vector<int> ids_;
+};
@@ -0,0 +1,108 @@
+#include "document_id_table.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+DocumentIdTable::DocumentIdTable(MemoryCounter* counter)
+	: entries_(CountingAllocator<Entry>(counter))
+	, ordinal_to_id_(CountingAllocator<int>(counter)) {
+}
+
+uint32_t DocumentIdTable::Add(int document_id) {
+	const uint32_t ordinal = static_cast<uint32_t>(ordinal_to_id_.size());
+	if (entries_.empty() || entries_.back().document_id < document_id) {
+		entries_.push_back({ document_id, ordinal });
+	}
+	else {
+		const auto it = entries_.begin() + (LowerBound(document_id) - entries_.cbegin());
+		if (it != entries_.end() && it->document_id == document_id) {
+			if (it->ordinal != REMOVED_ORDINAL) {
+				return it->ordinal;
+			}
+			// id удалённого документа добавлен снова
+			it->ordinal = ordinal;
+			--removed_entry_count_;
+		}
+		else {
+			entries_.insert(it, { document_id, ordinal });
+		}
+	}
+	ordinal_to_id_.push_back(document_id);
+	return ordinal;
+}
+
+void DocumentIdTable::Remove(int document_id) {
+	const auto it = entries_.begin() + (LowerBound(document_id) - entries_.cbegin());
+	if (it == entries_.end() || it->document_id != document_id || it->ordinal == REMOVED_ORDINAL) {
+		return;
+	}
+	it->ordinal = REMOVED_ORDINAL;
+	++removed_entry_count_;
+	if (removed_entry_count_ > size()) {
+		DropRemovedEntries();
+	}
+}
+
+bool DocumentIdTable::Contains(int document_id) const {
+	return FindOrdinal(document_id).has_value();
+}
+
+optional<uint32_t> DocumentIdTable::FindOrdinal(int document_id) const {
+	const auto it = LowerBound(document_id);
+	if (it == entries_.end() || it->document_id != document_id || it->ordinal == REMOVED_ORDINAL) {
+		return nullopt;
+	}
+	return it->ordinal;
+}
+
+int DocumentIdTable::GetId(uint32_t ordinal) const {
+	return ordinal_to_id_[ordinal];
+}
+
+size_t DocumentIdTable::size() const {
+	return entries_.size() - removed_entry_count_;
+}
+
+uint32_t DocumentIdTable::GetOrdinalCount() const {
+	return static_cast<uint32_t>(ordinal_to_id_.size());
+}
+
+vector<uint32_t> DocumentIdTable::Renumber() {
+	DropRemovedEntries();
+	vector<uint32_t> new_ordinals(ordinal_to_id_.size() + 1, 0);
+	for (const Entry& entry : entries_) {
+		new_ordinals[entry.ordinal + 1] = 1;
+	}
+	partial_sum(new_ordinals.begin(), new_ordinals.end(), new_ordinals.begin());
+
+	for (Entry& entry : entries_) {
+		entry.ordinal = new_ordinals[entry.ordinal];
+		ordinal_to_id_[entry.ordinal] = entry.document_id;
+	}
+	ordinal_to_id_.resize(entries_.size());
+	ordinal_to_id_.shrink_to_fit();
+	return new_ordinals;
+}
+
+DocumentIdTable::Iterator DocumentIdTable::begin() const {
+	return Iterator(entries_.begin(), entries_.end());
+}
+
+DocumentIdTable::Iterator DocumentIdTable::end() const {
+	return Iterator(entries_.end(), entries_.end());
+}
+
+DocumentIdTable::Entries::const_iterator DocumentIdTable::LowerBound(int document_id) const {
+	return lower_bound(entries_.begin(), entries_.end(), document_id, [](const Entry& entry, int id) {
+		return entry.document_id < id;
+		});
+}
+
+void DocumentIdTable::DropRemovedEntries() {
+	entries_.erase(remove_if(entries_.begin(), entries_.end(), [](const Entry& entry) {
+		return entry.ordinal == REMOVED_ORDINAL;
+		}), entries_.end());
+	removed_entry_count_ = 0;
+}
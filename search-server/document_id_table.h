@@ -0,0 +1,118 @@
+#pragma once
+#include "memory_stats.h"
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <vector>
+
+// Таблица соответствия внешних id документов плотным внутренним номерам (ordinal).
+// Номера выдаются по порядку добавления. Номера удалённых документов
+// освобождает Renumber, сдвигая живые документы с сохранением порядка.
+// Обход begin()/end() идёт по внешним id в порядке возрастания.
+// id хранятся в векторе, упорядоченном по id, и ищутся двоичным поиском.
+// Добавление возрастающих id - дописывание в конец. Удалённый id остаётся
+// в векторе с пометкой, пока помеченных не станет больше, чем живых
+class DocumentIdTable {
+    struct Entry {
+        int document_id;
+        uint32_t ordinal;
+    };
+    using Entries = std::vector<Entry, CountingAllocator<Entry>>;
+
+    static constexpr uint32_t REMOVED_ORDINAL = std::numeric_limits<uint32_t>::max();
+
+public:
+    // Обходит живые id, пропуская помеченные удалёнными
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        Iterator(Entries::const_iterator it, Entries::const_iterator end)
+            : it_(it)
+            , end_(end) {
+            SkipRemoved();
+        }
+
+        reference operator*() const {
+            return it_->document_id;
+        }
+        pointer operator->() const {
+            return &it_->document_id;
+        }
+        Iterator& operator++() {
+            ++it_;
+            SkipRemoved();
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator prev = *this;
+            ++*this;
+            return prev;
+        }
+        Iterator& operator--() {
+            do {
+                --it_;
+            } while (it_->ordinal == REMOVED_ORDINAL);
+            return *this;
+        }
+        Iterator operator--(int) {
+            Iterator prev = *this;
+            --*this;
+            return prev;
+        }
+        bool operator==(const Iterator& other) const {
+            return it_ == other.it_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return it_ != other.it_;
+        }
+
+    private:
+        Entries::const_iterator it_;
+        Entries::const_iterator end_;
+
+        void SkipRemoved() {
+            while (it_ != end_ && it_->ordinal == REMOVED_ORDINAL) {
+                ++it_;
+            }
+        }
+    };
+
+    explicit DocumentIdTable(MemoryCounter* counter = nullptr);
+
+    uint32_t Add(int document_id);
+    void Remove(int document_id);
+
+    bool Contains(int document_id) const;
+    std::optional<uint32_t> FindOrdinal(int document_id) const;
+    int GetId(uint32_t ordinal) const;
+
+    // Количество живых документов
+    size_t size() const;
+    // Количество выданных номеров, включая удалённые документы
+    uint32_t GetOrdinalCount() const;
+
+    // Перенумеровывает живые документы подряд с нуля. Возвращает new_ordinals
+    // на GetOrdinalCount() + 1 элементов: new_ordinals[ordinal] - число живых
+    // документов с меньшими номерами, то есть новый номер живого документа
+    std::vector<uint32_t> Renumber();
+
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    Entries entries_;
+    size_t removed_entry_count_ = 0;
+    std::vector<int, CountingAllocator<int>> ordinal_to_id_;
+
+    // Первая запись с id не меньше document_id
+    Entries::const_iterator LowerBound(int document_id) const;
+    // Выбрасывает из entries_ записи удалённых документов
+    void DropRemovedEntries();
+};
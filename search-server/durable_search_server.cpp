@@ -0,0 +1,143 @@
+#include "durable_search_server.h"
+#include "corpus_loader.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+DurableSearchServer::DurableSearchServer(SearchServer& search_server, const string& directory, WalSyncMode sync_mode)
+	: search_server_(search_server)
+	, directory_(directory)
+	, snapshot_path_((filesystem::path(directory) / "snapshot.tsv"s).string())
+	, log_path_((filesystem::path(directory) / "journal.wal"s).string())
+	, sync_mode_(sync_mode)
+	, recovery_stats_(Recover())
+	, log_(log_path_, recovery_stats_.valid_size)
+{
+	if (sync_mode_ == WalSyncMode::GROUP) {
+		flusher_ = thread([this] {
+			RunFlusher();
+			});
+	}
+}
+
+DurableSearchServer::~DurableSearchServer() {
+	{
+		lock_guard lock(flusher_mutex_);
+		stopping_ = true;
+	}
+	flusher_wakeup_.notify_all();
+	if (flusher_.joinable()) {
+		flusher_.join();
+	}
+}
+
+void DurableSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+	uint64_t lsn = 0;
+	{
+		lock_guard lock(write_mutex_);
+		// Занятый id отвергается до журнала: отменяющая запись ниже удалила бы прежний документ
+		if ((document_id < 0) || search_server_.HasDocument(document_id)) {
+			throw invalid_argument("Invalid document_id"s);
+		}
+		lsn = log_.AppendAdd(document_id, document, status, ratings);
+		try {
+			search_server_.AddDocument(document_id, document, status, ratings);
+		}
+		catch (...) {
+			// Запись могла уже уйти на диск, поэтому она отменяется следующей записью.
+			// При восстановлении документ либо не добавится снова, либо сразу удалится
+			log_.AppendRemove(document_id);
+			throw;
+		}
+	}
+	Commit(lsn);
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+	uint64_t lsn = 0;
+	{
+		lock_guard lock(write_mutex_);
+		lsn = log_.AppendRemove(document_id);
+		search_server_.RemoveDocument(document_id);
+	}
+	Commit(lsn);
+}
+
+void DurableSearchServer::Sync() {
+	log_.Sync();
+}
+
+void DurableSearchServer::Checkpoint() {
+	lock_guard lock(write_mutex_);
+	log_.Sync();
+
+	// Снимок пишется во временный файл и атомарно подменяет старый
+	const string temporary_path = snapshot_path_ + ".tmp"s;
+	{
+		ofstream output(temporary_path, ios::binary | ios::trunc);
+		SaveCorpus(search_server_, output);
+		output.flush();
+		if (!output) {
+			throw runtime_error("Cannot write snapshot "s + temporary_path);
+		}
+	}
+	SyncPath(temporary_path);
+	filesystem::rename(temporary_path, snapshot_path_);
+	SyncPath(directory_);
+	log_.Truncate();
+}
+
+const WalReplayStats& DurableSearchServer::GetRecoveryStats() const {
+	return recovery_stats_;
+}
+
+WalReplayStats DurableSearchServer::Recover() {
+	filesystem::create_directories(directory_);
+	if (filesystem::exists(snapshot_path_)) {
+		LoadCorpus(search_server_, snapshot_path_);
+	}
+	// Сбой между сохранением снимка и очисткой журнала оставляет в журнале
+	// уже учтённые изменения. Их повторное применение сходится к тому же
+	// состоянию: добавление занятого id пропускается, а итог для каждого id
+	// определяет последняя операция с ним в журнале. Добавление, которое
+	// сервер отверг при записи, отвергается снова или отменяется следующей записью
+	return WriteAheadLog::Replay(log_path_, [this](const WalRecord& record) {
+		if (record.type == WalRecordType::REMOVE_DOCUMENT) {
+			search_server_.RemoveDocument(record.document_id);
+			return;
+		}
+		try {
+			search_server_.AddDocument(record.document_id, record.text, record.status, record.ratings);
+		}
+		catch (const invalid_argument&) {
+		}
+		});
+}
+
+void DurableSearchServer::Commit(uint64_t lsn) {
+	if (sync_mode_ == WalSyncMode::EACH_WRITE || log_.GetUnsyncedSize() >= WAL_GROUP_COMMIT_SIZE) {
+		log_.Sync(lsn);
+	}
+}
+
+void DurableSearchServer::RunFlusher() {
+	unique_lock lock(flusher_mutex_);
+	while (!flusher_wakeup_.wait_for(lock, WAL_GROUP_COMMIT_INTERVAL, [this] {
+		return stopping_;
+		})) {
+		lock.unlock();
+		try {
+			if (log_.GetUnsyncedSize() > 0) {
+				log_.Sync();
+			}
+		}
+		catch (const exception&) {
+			// Несброшенные записи остаются в буфере до следующей попытки,
+			// а сломанный журнал отвергает следующие изменения сам
+		}
+		lock.lock();
+	}
+}
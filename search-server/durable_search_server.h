@@ -0,0 +1,64 @@
+#pragma once
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+enum class WalSyncMode {
+    // AddDocument и RemoveDocument возвращаются, когда их запись уже на диске.
+    // Писатели из разных потоков делят один fsync
+    EACH_WRITE,
+    // fsync раз в WAL_GROUP_COMMIT_SIZE байт журнала, но не реже раза в WAL_GROUP_COMMIT_INTERVAL.
+    // При сбое теряется не больше одной группы
+    GROUP,
+};
+
+const size_t WAL_GROUP_COMMIT_SIZE = 1 << 20;
+const std::chrono::milliseconds WAL_GROUP_COMMIT_INTERVAL(50);
+
+// Сервер с журналом изменений. В каталоге хранятся снимок индекса в формате
+// LoadCorpus и журнал изменений, сделанных после снимка. При создании снимок
+// загружается в search_server, а журнал проигрывается поверх него.
+// Изменение сначала попадает в журнал и только потом в search_server.
+// Checkpoint сохраняет новый снимок и очищает журнал.
+// Изменять индекс можно из нескольких потоков, искать - пока изменений нет.
+class DurableSearchServer {
+public:
+    DurableSearchServer(SearchServer& search_server, const std::string& directory, WalSyncMode sync_mode = WalSyncMode::EACH_WRITE);
+    ~DurableSearchServer();
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    // Сбрасывает на диск все сделанные изменения
+    void Sync();
+    void Checkpoint();
+
+    const WalReplayStats& GetRecoveryStats() const;
+
+private:
+    SearchServer& search_server_;
+    std::string directory_;
+    std::string snapshot_path_;
+    std::string log_path_;
+    WalSyncMode sync_mode_;
+    WalReplayStats recovery_stats_;
+    WriteAheadLog log_;
+    std::mutex write_mutex_;
+
+    // Поток, который в режиме GROUP сбрасывает журнал по времени
+    std::mutex flusher_mutex_;
+    std::condition_variable flusher_wakeup_;
+    bool stopping_ = false;
+    std::thread flusher_;
+
+    WalReplayStats Recover();
+    void Commit(uint64_t lsn);
+    void RunFlusher();
+};
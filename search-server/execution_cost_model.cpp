@@ -0,0 +1,132 @@
+#include "execution_cost_model.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const int CALIBRATION_DOCUMENT_COUNT = 2000;
+const int CALIBRATION_DOCUMENT_WORDS = 30;
+const int CALIBRATION_DICTIONARY_SIZE = 300;
+// Нечётное число замеров, чтобы медиана была одним из них
+const int CALIBRATION_SAMPLES = 7;
+
+string MakeText(mt19937& generator, int word_count) {
+	string text;
+	for (int i = 0; i < word_count; ++i) {
+		if (!text.empty()) {
+			text.push_back(' ');
+		}
+		text += "w"s + to_string(uniform_int_distribution(0, CALIBRATION_DICTIONARY_SIZE - 1)(generator));
+	}
+	return text;
+}
+
+double GetMedian(vector<double> samples) {
+	const auto middle = samples.begin() + samples.size() / 2;
+	nth_element(samples.begin(), middle, samples.end());
+	return *middle;
+}
+
+template <typename Function>
+double MeasureOnce(Function function) {
+	const auto start = chrono::steady_clock::now();
+	function();
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+// Медиана времени нескольких замеров, в микросекундах: один медленный
+// или быстрый замер (вытеснение потока, прогрев кэша) не сдвигает порог
+template <typename Function>
+double Measure(Function function) {
+	vector<double> samples;
+	for (int i = 0; i < CALIBRATION_SAMPLES; ++i) {
+		samples.push_back(MeasureOnce(function));
+	}
+	return GetMedian(move(samples));
+}
+
+ExecutionThresholds execution_thresholds;
+
+}  // namespace
+
+ExecutionThresholds CalibrateExecutionThresholds() {
+	mt19937 generator;
+	SearchServer search_server(""s);
+	for (int id = 0; id < CALIBRATION_DOCUMENT_COUNT; ++id) {
+		search_server.AddDocument(id, MakeText(generator, CALIBRATION_DOCUMENT_WORDS), DocumentStatus::ACTUAL, {});
+	}
+	const size_t postings_per_word = CALIBRATION_DOCUMENT_COUNT * CALIBRATION_DOCUMENT_WORDS / CALIBRATION_DICTIONARY_SIZE;
+
+	ExecutionThresholds thresholds;
+	for (int word_count = 1; word_count <= 128; word_count *= 2) {
+		const string query = MakeText(generator, word_count);
+		const double seq_time = Measure([&] { search_server.FindTopDocuments(execution::seq, query); });
+		const double par_time = Measure([&] { search_server.FindTopDocuments(execution::par, query); });
+		const double shard_time = Measure([&] { search_server.FindTopDocuments(SHARD_PARALLEL_POLICY, query); });
+
+		const size_t posting_count = postings_per_word * word_count;
+		if (thresholds.parallel_min_postings == SIZE_MAX && min(par_time, shard_time) < seq_time) {
+			thresholds.parallel_min_postings = posting_count;
+		}
+		if (thresholds.shard_min_postings == SIZE_MAX && shard_time < min(seq_time, par_time)) {
+			thresholds.shard_min_postings = posting_count;
+		}
+		if (thresholds.match_parallel_min_words == SIZE_MAX) {
+			const double match_seq_time = Measure([&] { search_server.MatchDocument(execution::seq, query, 0); });
+			const double match_par_time = Measure([&] { search_server.MatchDocument(execution::par, query, 0); });
+			if (match_par_time < match_seq_time) {
+				thresholds.match_parallel_min_words = word_count;
+			}
+		}
+	}
+
+	// Удаление замеряется на документах с заданным числом различных слов
+	int next_id = CALIBRATION_DOCUMENT_COUNT;
+	for (int word_count = 16; word_count <= 1024 && thresholds.remove_parallel_min_words == SIZE_MAX; word_count *= 2) {
+		string text;
+		for (int i = 0; i < word_count; ++i) {
+			text += "r"s + to_string(i) + " "s;
+		}
+		text.pop_back();
+		vector<double> seq_samples;
+		vector<double> par_samples;
+		for (int i = 0; i < CALIBRATION_SAMPLES; ++i) {
+			search_server.AddDocument(next_id, text, DocumentStatus::ACTUAL, {});
+			seq_samples.push_back(MeasureOnce([&] { search_server.RemoveDocument(execution::seq, next_id); }));
+			++next_id;
+			search_server.AddDocument(next_id, text, DocumentStatus::ACTUAL, {});
+			par_samples.push_back(MeasureOnce([&] { search_server.RemoveDocument(execution::par, next_id); }));
+			++next_id;
+		}
+		if (GetMedian(move(par_samples)) < GetMedian(move(seq_samples))) {
+			thresholds.remove_parallel_min_words = word_count;
+		}
+	}
+	return thresholds;
+}
+
+void SetExecutionThresholds(const ExecutionThresholds& thresholds) {
+	execution_thresholds = thresholds;
+}
+
+const ExecutionThresholds& GetExecutionThresholds() {
+	return execution_thresholds;
+}
+
+ExecutionMode ChooseSearchMode(size_t posting_count) {
+	const auto& thresholds = GetExecutionThresholds();
+	if (posting_count >= thresholds.shard_min_postings) {
+		return ExecutionMode::SHARD_PARALLEL;
+	}
+	if (posting_count >= thresholds.parallel_min_postings) {
+		return ExecutionMode::INTRA_QUERY_PARALLEL;
+	}
+	return ExecutionMode::SEQUENTIAL;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Политика выполнения, при которой сервер сам выбирает способ выполнения
+// запроса по оценке его стоимости
+struct AdaptivePolicy {
+};
+
+inline constexpr AdaptivePolicy ADAPTIVE_POLICY{};
+
+// Политика выполнения запроса по диапазонам внутренних номеров документов
+struct ShardParallelPolicy {
+};
+
+inline constexpr ShardParallelPolicy SHARD_PARALLEL_POLICY{};
+
+enum class ExecutionMode {
+    SEQUENTIAL,
+    // Слова запроса обрабатываются параллельно, релевантность копится в ConcurrentMap
+    INTRA_QUERY_PARALLEL,
+    // Документы делятся на диапазоны внутренних номеров, каждый диапазон
+    // обрабатывается отдельным потоком без блокировок
+    SHARD_PARALLEL,
+};
+
+struct ExecutionThresholds {
+    // Пороги по суммарной длине списков документов слов запроса
+    size_t parallel_min_postings = SIZE_MAX;
+    size_t shard_min_postings = SIZE_MAX;
+    // Пороги по числу слов запроса и числу слов удаляемого документа
+    size_t match_parallel_min_words = SIZE_MAX;
+    size_t remove_parallel_min_words = SIZE_MAX;
+};
+
+// Замеряет все способы выполнения на синтетическом индексе и находит точки,
+// где параллельное выполнение начинает выигрывать. Каждое время - медиана
+// нескольких замеров. Занимает десятки миллисекунд
+ExecutionThresholds CalibrateExecutionThresholds();
+
+// Пороги для AdaptivePolicy задаются при запуске, до первого запроса, например
+// SetExecutionThresholds(CalibrateExecutionThresholds()). Запросы их только читают,
+// поэтому менять пороги во время запросов нельзя. Без калибровки всё выполняется последовательно
+void SetExecutionThresholds(const ExecutionThresholds& thresholds);
+const ExecutionThresholds& GetExecutionThresholds();
+
+ExecutionMode ChooseSearchMode(size_t posting_count);
@@ -0,0 +1,77 @@
+#include "forward_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ForwardIndex::ForwardIndex(MemoryCounter* counter)
+	: entries_(CountingAllocator<TermFrequency>(counter))
+	, ranges_(CountingAllocator<Range>(counter)) {
+}
+
+void ForwardIndex::AddDocument(uint32_t ordinal, vector<TermFrequency> entries) {
+	sort(entries.begin(), entries.end(), [](const TermFrequency& lhs, const TermFrequency& rhs) {
+		return lhs.term_id < rhs.term_id;
+		});
+	if (ranges_.size() <= ordinal) {
+		ranges_.resize(ordinal + 1);
+	}
+	ranges_[ordinal] = { entries_.size(), entries.size() };
+	entries_.insert(entries_.end(), entries.begin(), entries.end());
+}
+
+void ForwardIndex::RemoveDocument(uint32_t ordinal) {
+	if (ordinal >= ranges_.size()) {
+		return;
+	}
+	dead_entries_ += ranges_[ordinal].size;
+	ranges_[ordinal] = {};
+	if (dead_entries_ * 2 > entries_.size()) {
+		Compact();
+	}
+}
+
+pair<const TermFrequency*, const TermFrequency*> ForwardIndex::GetEntries(uint32_t ordinal) const {
+	if (ordinal >= ranges_.size()) {
+		return { nullptr, nullptr };
+	}
+	const TermFrequency* first = entries_.data() + ranges_[ordinal].offset;
+	return { first, first + ranges_[ordinal].size };
+}
+
+bool ForwardIndex::HasTerm(uint32_t ordinal, uint32_t term_id) const {
+	return FindEntry(ordinal, term_id) != nullptr;
+}
+
+const TermFrequency* ForwardIndex::FindEntry(uint32_t ordinal, uint32_t term_id) const {
+	const auto [first, last] = GetEntries(ordinal);
+	const auto it = lower_bound(first, last, term_id, [](const TermFrequency& entry, uint32_t id) {
+		return entry.term_id < id;
+		});
+	return it != last && it->term_id == term_id ? it : nullptr;
+}
+
+void ForwardIndex::Compact() {
+	vector<TermFrequency, CountingAllocator<TermFrequency>> compacted(entries_.get_allocator());
+	compacted.reserve(entries_.size() - dead_entries_);
+	for (Range& range : ranges_) {
+		const auto first = entries_.begin() + range.offset;
+		range.offset = compacted.size();
+		compacted.insert(compacted.end(), first, first + range.size);
+	}
+	entries_ = move(compacted);
+	dead_entries_ = 0;
+}
+
+void ForwardIndex::Compact(const vector<uint32_t>& new_ordinals) {
+	// Новые номера не больше старых, поэтому диапазоны сдвигаются на месте
+	const uint32_t ordinal_count = static_cast<uint32_t>(min(ranges_.size(), new_ordinals.size() - 1));
+	for (uint32_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+		if (new_ordinals[ordinal] != new_ordinals[ordinal + 1]) {
+			ranges_[new_ordinals[ordinal]] = ranges_[ordinal];
+		}
+	}
+	ranges_.resize(new_ordinals[ordinal_count]);
+	ranges_.shrink_to_fit();
+	Compact();
+}
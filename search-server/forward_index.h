@@ -0,0 +1,112 @@
+#pragma once
+#include "memory_stats.h"
+#include "term_dictionary.h"
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct TermFrequency {
+    uint32_t term_id;
+    float term_freq;
+};
+
+// Лёгкое представление частот слов одного документа поверх прямого индекса.
+// Действительно до следующего изменения индекса. Слова восстанавливаются
+// из словаря при разыменовании итератора.
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const TermFrequency* entry, const TermDictionary* dictionary)
+            : entry_(entry)
+            , dictionary_(dictionary) {
+        }
+
+        value_type operator*() const {
+            return { dictionary_->GetWord(entry_->term_id), entry_->term_freq };
+        }
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator prev = *this;
+            ++entry_;
+            return prev;
+        }
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        const TermFrequency* entry_;
+        const TermDictionary* dictionary_;
+    };
+
+    WordFrequencies() = default;
+    WordFrequencies(const TermFrequency* begin, const TermFrequency* end, const TermDictionary* dictionary)
+        : begin_(begin)
+        , end_(end)
+        , dictionary_(dictionary) {
+    }
+
+    Iterator begin() const {
+        return { begin_, dictionary_ };
+    }
+    Iterator end() const {
+        return { end_, dictionary_ };
+    }
+    size_t size() const {
+        return end_ - begin_;
+    }
+    bool empty() const {
+        return begin_ == end_;
+    }
+
+private:
+    const TermFrequency* begin_ = nullptr;
+    const TermFrequency* end_ = nullptr;
+    const TermDictionary* dictionary_ = nullptr;
+};
+
+// Прямой индекс в формате CSR: записи (term id, tf) всех документов лежат
+// в одном буфере, для каждого документа хранится только его диапазон.
+// Документы адресуются внутренними номерами (ordinal), записи документа
+// упорядочены по term id.
+class ForwardIndex {
+public:
+    explicit ForwardIndex(MemoryCounter* counter = nullptr);
+
+    void AddDocument(uint32_t ordinal, std::vector<TermFrequency> entries);
+    void RemoveDocument(uint32_t ordinal);
+
+    std::pair<const TermFrequency*, const TermFrequency*> GetEntries(uint32_t ordinal) const;
+    bool HasTerm(uint32_t ordinal, uint32_t term_id) const;
+    // Запись слова в документе или nullptr
+    const TermFrequency* FindEntry(uint32_t ordinal, uint32_t term_id) const;
+
+    void Compact();
+    // Compact с переносом документов на номера new_ordinals из DocumentIdTable::Renumber
+    void Compact(const std::vector<uint32_t>& new_ordinals);
+
+private:
+    struct Range {
+        size_t offset = 0;
+        size_t size = 0;
+    };
+    std::vector<TermFrequency, CountingAllocator<TermFrequency>> entries_;
+    std::vector<Range, CountingAllocator<Range>> ranges_;
+    size_t dead_entries_ = 0;
+};
@@ -0,0 +1,183 @@
+#include "hot_term_cache.h"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+using namespace std;
+
+HotTermCache::HotTermCache(MemoryCounter* counter)
+	: counter_(counter)
+	, query_counters_(HOT_TERM_COUNTER_COUNT, CountingAllocator<QueryCounter>(counter)) {
+}
+
+void HotTermCache::RecordQuery(uint32_t term_id) {
+	// Счётчик делят слова с одинаковым остатком: запрос чужого слова уменьшает его,
+	// и счётчик достаётся новому слову, только когда опустится до нуля
+	QueryCounter& counter = query_counters_[term_id % HOT_TERM_COUNTER_COUNT];
+	if (counter.term_id.load(memory_order_relaxed) == term_id) {
+		counter.count.fetch_add(1, memory_order_relaxed);
+	}
+	else if (uint32_t count = counter.count.load(memory_order_relaxed); count == 0) {
+		counter.term_id.store(term_id, memory_order_relaxed);
+		counter.count.store(1, memory_order_relaxed);
+	}
+	else {
+		counter.count.compare_exchange_weak(count, count - 1, memory_order_relaxed);
+	}
+	recorded_query_count_.fetch_add(1, memory_order_relaxed);
+}
+
+bool HotTermCache::IsUpdateDue() const {
+	return recorded_query_count_.load(memory_order_relaxed) - updated_query_count_.load(memory_order_relaxed) >= HOT_TERM_UPDATE_PERIOD;
+}
+
+vector<uint32_t> HotTermCache::StartUpdate() {
+	const uint32_t recorded_query_count = recorded_query_count_.load(memory_order_relaxed);
+	updated_query_count_.store(recorded_query_count, memory_order_relaxed);
+	uint32_t aged_query_count = aged_query_count_.load(memory_order_relaxed);
+	if (recorded_query_count - aged_query_count >= HOT_TERM_AGING_PERIOD
+		&& aged_query_count_.compare_exchange_strong(aged_query_count, recorded_query_count, memory_order_relaxed)) {
+		AgeQueryCounts();
+	}
+
+	vector<uint32_t> term_ids;
+	vector<pair<uint32_t, uint32_t>> candidates;
+	shared_lock lock(lists_mutex_);
+	for (const QueryCounter& counter : query_counters_) {
+		const uint32_t term_id = counter.term_id.load(memory_order_relaxed);
+		const uint32_t count = counter.count.load(memory_order_relaxed);
+		if (count < HOT_TERM_MIN_QUERIES) {
+			continue;
+		}
+		const auto list = lists_.find(term_id);
+		if (list == lists_.end()) {
+			candidates.emplace_back(count, term_id);
+		}
+		else if (list->second.stale) {
+			term_ids.push_back(term_id);
+		}
+	}
+	// Свободные места получают самые запрашиваемые слова
+	const size_t free_count = min(candidates.size(), HOT_TERM_COUNT - min(lists_.size(), HOT_TERM_COUNT));
+	partial_sort(candidates.begin(), candidates.begin() + free_count, candidates.end(), greater<>());
+	for (size_t i = 0; i < free_count; ++i) {
+		term_ids.push_back(candidates[i].second);
+	}
+	return term_ids;
+}
+
+void HotTermCache::Install(uint32_t term_id, vector<Posting> postings) {
+	// Список готовится до блокировки, чтобы не задерживать читателей
+	const size_t size = min(postings.size(), HOT_TERM_LIST_SIZE);
+	partial_sort(postings.begin(), postings.begin() + size, postings.end(), IsImpactOrdered);
+	ImpactList list{ decltype(ImpactList::postings)(postings.begin(), postings.begin() + size, CountingAllocator<Posting>(counter_)) };
+	if (size < postings.size()) {
+		list.cut = *min_element(postings.begin() + size, postings.end(), IsImpactOrdered);
+		list.complete = false;
+	}
+
+	unique_lock lock(lists_mutex_);
+	if (lists_.count(term_id) == 0 && lists_.size() >= HOT_TERM_COUNT) {
+		return;
+	}
+	lists_.insert_or_assign(term_id, move(list));
+}
+
+shared_lock<shared_mutex> HotTermCache::LockShared() const {
+	return shared_lock(lists_mutex_);
+}
+
+const ImpactList* HotTermCache::Find(uint32_t term_id) const {
+	const auto list = lists_.find(term_id);
+	if (list == lists_.end() || list->second.stale) {
+		return nullptr;
+	}
+	return &list->second;
+}
+
+void HotTermCache::AddDocument(uint32_t ordinal, const vector<TermFrequency>& entries) {
+	unique_lock lock(lists_mutex_);
+	if (lists_.empty()) {
+		return;
+	}
+	for (const TermFrequency& entry : entries) {
+		const auto it = lists_.find(entry.term_id);
+		if (it == lists_.end()) {
+			continue;
+		}
+		ImpactList& list = it->second;
+		const Posting posting = { ordinal, entry.term_freq };
+		if (!list.Contains(posting)) {
+			continue;
+		}
+		list.postings.insert(upper_bound(list.postings.begin(), list.postings.end(), posting, IsImpactOrdered), posting);
+		// Список растёт не больше чем вдвое, затем хвост отрезается
+		if (list.postings.size() > 2 * HOT_TERM_LIST_SIZE) {
+			list.cut = list.postings[HOT_TERM_LIST_SIZE];
+			list.complete = false;
+			list.postings.resize(HOT_TERM_LIST_SIZE);
+		}
+	}
+}
+
+void HotTermCache::RemoveDocument(uint32_t ordinal, const TermFrequency* first, const TermFrequency* last) {
+	unique_lock lock(lists_mutex_);
+	if (lists_.empty()) {
+		return;
+	}
+	for (const TermFrequency* entry = first; entry != last; ++entry) {
+		const auto it = lists_.find(entry->term_id);
+		if (it == lists_.end()) {
+			continue;
+		}
+		ImpactList& list = it->second;
+		const Posting posting = { ordinal, entry->term_freq };
+		if (!list.Contains(posting)) {
+			continue;
+		}
+		const auto position = lower_bound(list.postings.begin(), list.postings.end(), posting, IsImpactOrdered);
+		if (position != list.postings.end() && position->ordinal == ordinal) {
+			list.postings.erase(position);
+		}
+		if (!list.complete && list.postings.size() < HOT_TERM_LIST_SIZE / 2) {
+			list.stale = true;
+		}
+	}
+}
+
+void HotTermCache::Renumber(const vector<uint32_t>& new_ordinals) {
+	unique_lock lock(lists_mutex_);
+	// Перенумерация сохраняет порядок номеров, поэтому порядок списков не меняется.
+	// Граница может принадлежать удалённому документу: её новый номер отделяет
+	// те же живые документы, что и старый
+	for (auto& [term_id, list] : lists_) {
+		for (Posting& posting : list.postings) {
+			posting.ordinal = new_ordinals[posting.ordinal];
+		}
+		list.cut.ordinal = new_ordinals[list.cut.ordinal];
+	}
+}
+
+size_t HotTermCache::size() const {
+	shared_lock lock(lists_mutex_);
+	return lists_.size();
+}
+
+uint32_t HotTermCache::GetQueryCount(uint32_t term_id) const {
+	const QueryCounter& counter = query_counters_[term_id % HOT_TERM_COUNTER_COUNT];
+	return counter.term_id.load(memory_order_relaxed) == term_id ? counter.count.load(memory_order_relaxed) : 0;
+}
+
+void HotTermCache::AgeQueryCounts() {
+	// Запросы, учтённые между чтением и записью счётчика, теряются: счётчики приблизительные
+	for (QueryCounter& counter : query_counters_) {
+		counter.count.store(counter.count.load(memory_order_relaxed) / 2, memory_order_relaxed);
+	}
+	// Место освобождается только здесь, а не при каждом новом частом слове:
+	// иначе при равномерных запросах к многим словам списки постоянно перестраивались бы
+	unique_lock lock(lists_mutex_);
+	for (auto it = lists_.begin(); it != lists_.end();) {
+		it = GetQueryCount(it->first) < HOT_TERM_MIN_QUERIES ? lists_.erase(it) : next(it);
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "forward_index.h"
+#include "index_segment.h"
+#include "memory_stats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+// Сколько слов одновременно держат упорядоченные по частоте списки
+const size_t HOT_TERM_COUNT = 256;
+// Сколько лучших записей списка документов хранится для слова
+const size_t HOT_TERM_LIST_SIZE = 256;
+// Слова из меньшего числа документов дёшево обработать обычным поиском
+const uint32_t HOT_TERM_MIN_DOCUMENTS = 4 * HOT_TERM_LIST_SIZE;
+// Сколько запросов со словом нужно, чтобы построить для него список
+const uint32_t HOT_TERM_MIN_QUERIES = 4;
+// Число счётчиков запросов: слово считается в счётчике term_id % HOT_TERM_COUNTER_COUNT
+const size_t HOT_TERM_COUNTER_COUNT = 1 << 14;
+// Через сколько учтённых запросов обновление строит списки новых частых слов
+const uint32_t HOT_TERM_UPDATE_PERIOD = 1 << 10;
+// Через сколько учтённых запросов счётчики делятся пополам, а списки
+// слов, которые перестали запрашивать, удаляются
+const uint32_t HOT_TERM_AGING_PERIOD = 1 << 16;
+
+// Порядок записей в упорядоченном списке: по убыванию частоты слова, при равной частоте - по номеру
+inline bool IsImpactOrdered(const Posting& lhs, const Posting& rhs) {
+    return lhs.term_freq > rhs.term_freq || (lhs.term_freq == rhs.term_freq && lhs.ordinal < rhs.ordinal);
+}
+
+// Начало списка документов слова в порядке IsImpactOrdered: все записи,
+// стоящие раньше cut, или все записи слова, если список полный
+struct ImpactList {
+    std::vector<Posting, CountingAllocator<Posting>> postings;
+    Posting cut = { 0, 0.0f };
+    bool complete = true;
+    // Удаления сократили неполный список, его нужно построить заново
+    bool stale = false;
+
+    bool Contains(const Posting& posting) const {
+        return complete || IsImpactOrdered(posting, cut);
+    }
+    // Просмотрена ли запись при обходе списка до позиции position
+    bool IsConsumed(const Posting& posting, size_t position) const {
+        return Contains(posting) && (position == postings.size() || IsImpactOrdered(posting, postings[position]));
+    }
+};
+
+// Упорядоченные по частоте списки самых запрашиваемых слов. По ним лучшие
+// документы запроса из одного-двух слов находятся просмотром нескольких первых
+// записей. Частота слова в документе не зависит от остальных документов,
+// поэтому списки обновляются при добавлении и удалении документов, а не строятся заново.
+// Запросы могут идти из нескольких потоков: они только увеличивают атомарные
+// счётчики и читают списки под разделяемой блокировкой. Новые списки строит
+// обновление (StartUpdate и Install) вне запросов.
+class HotTermCache {
+public:
+    explicit HotTermCache(MemoryCounter* counter);
+
+    // Учитывает запрос со словом без блокировок. Счётчики приблизительные:
+    // слова с общим счётчиком вытесняют друг друга, а при гонках запрос может потеряться
+    void RecordQuery(uint32_t term_id);
+    // С прошлого обновления учтено не меньше HOT_TERM_UPDATE_PERIOD запросов
+    bool IsUpdateDue() const;
+    // Начинает обновление: раз в HOT_TERM_AGING_PERIOD запросов старит счётчики
+    // и удаляет остывшие списки. Возвращает частые слова, для которых нужно построить список
+    std::vector<uint32_t> StartUpdate();
+    // Сохраняет список, построенный из всех записей слова, если для него есть место
+    void Install(uint32_t term_id, std::vector<Posting> postings);
+
+    std::shared_lock<std::shared_mutex> LockShared() const;
+    // Действующий список слова или nullptr. Вызывается под LockShared
+    const ImpactList* Find(uint32_t term_id) const;
+
+    void AddDocument(uint32_t ordinal, const std::vector<TermFrequency>& entries);
+    void RemoveDocument(uint32_t ordinal, const TermFrequency* first, const TermFrequency* last);
+    // Переносит записи списков на номера new_ordinals из DocumentIdTable::Renumber
+    void Renumber(const std::vector<uint32_t>& new_ordinals);
+
+    size_t size() const;
+
+private:
+    struct QueryCounter {
+        std::atomic<uint32_t> term_id{ 0 };
+        std::atomic<uint32_t> count{ 0 };
+    };
+
+    MemoryCounter* counter_;
+
+    std::vector<QueryCounter, CountingAllocator<QueryCounter>> query_counters_;
+    // Число учтённых запросов всего, при последнем обновлении и при последнем старении
+    std::atomic<uint32_t> recorded_query_count_{ 0 };
+    std::atomic<uint32_t> updated_query_count_{ 0 };
+    std::atomic<uint32_t> aged_query_count_{ 0 };
+
+    mutable std::shared_mutex lists_mutex_;
+    std::unordered_map<uint32_t, ImpactList> lists_;
+
+    uint32_t GetQueryCount(uint32_t term_id) const;
+    void AgeQueryCounts();
+};
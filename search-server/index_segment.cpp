@@ -0,0 +1,171 @@
+#include "index_segment.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+const Posting* PostingList::LowerBound(uint32_t ordinal) const {
+	return lower_bound(begin_, end_, ordinal, [](const Posting& posting, uint32_t value) {
+		return posting.ordinal < value;
+		});
+}
+
+const Posting* PostingList::Find(uint32_t ordinal) const {
+	const Posting* posting = LowerBound(ordinal);
+	return posting != end_ && posting->ordinal == ordinal ? posting : nullptr;
+}
+
+MutableSegment::MutableSegment(MemoryCounter* counter)
+	: counter_(counter)
+	, postings_(CountingAllocator<pair<const uint32_t, Postings>>(counter)) {
+}
+
+void MutableSegment::AddDocument(uint32_t ordinal, const vector<TermFrequency>& entries) {
+	if (document_count_ == 0) {
+		first_ordinal_ = ordinal;
+	}
+	++document_count_;
+	last_ordinal_ = ordinal + 1;
+	for (const auto [term_id, term_freq] : entries) {
+		postings_.try_emplace(term_id, CountingAllocator<Posting>(counter_)).first->second.push_back({ ordinal, term_freq });
+	}
+}
+
+void MutableSegment::Clear() {
+	postings_.clear();
+	document_count_ = 0;
+	first_ordinal_ = 0;
+	last_ordinal_ = 0;
+}
+
+PostingList MutableSegment::GetPostings(uint32_t term_id) const {
+	const auto it = postings_.find(term_id);
+	if (it == postings_.end()) {
+		return {};
+	}
+	return { it->second.data(), it->second.data() + it->second.size() };
+}
+
+size_t MutableSegment::GetDocumentCount() const {
+	return document_count_;
+}
+
+bool MutableSegment::empty() const {
+	return document_count_ == 0;
+}
+
+uint32_t MutableSegment::GetFirstOrdinal() const {
+	return first_ordinal_;
+}
+
+uint32_t MutableSegment::GetLastOrdinal() const {
+	return last_ordinal_;
+}
+
+SealedSegment::SealedSegment(const MutableSegment& segment, const DocumentBitmap& alive, MemoryCounter* counter)
+	: term_ids_(CountingAllocator<uint32_t>(counter))
+	, offsets_(CountingAllocator<uint32_t>(counter))
+	, postings_(CountingAllocator<Posting>(counter))
+	, first_ordinal_(segment.GetFirstOrdinal())
+	, last_ordinal_(segment.GetLastOrdinal()) {
+	offsets_.push_back(0);
+	segment.ForEachTerm([&](uint32_t term_id, PostingList postings) {
+		AppendAlivePostings(postings, alive);
+		CloseTerm(term_id);
+		});
+	postings_.shrink_to_fit();
+	term_ids_.shrink_to_fit();
+	offsets_.shrink_to_fit();
+}
+
+SealedSegment::SealedSegment(const vector<shared_ptr<const SealedSegment>>& segments, const DocumentBitmap& alive,
+	int level, MemoryCounter* counter, const vector<uint32_t>* new_ordinals)
+	: term_ids_(CountingAllocator<uint32_t>(counter))
+	, offsets_(CountingAllocator<uint32_t>(counter))
+	, postings_(CountingAllocator<Posting>(counter))
+	, level_(level) {
+	size_t posting_count = 0;
+	for (const auto& segment : segments) {
+		posting_count += segment->postings_.size();
+	}
+	postings_.reserve(posting_count);
+	if (!segments.empty()) {
+		first_ordinal_ = segments.front()->first_ordinal_;
+		last_ordinal_ = segments.back()->last_ordinal_;
+	}
+	if (new_ordinals) {
+		first_ordinal_ = (*new_ordinals)[first_ordinal_];
+		last_ordinal_ = (*new_ordinals)[last_ordinal_];
+	}
+
+	// Слияние каталогов слов: сегменты идут по возрастанию номеров,
+	// поэтому списки слова из них достаточно дописать друг за другом
+	offsets_.push_back(0);
+	vector<size_t> positions(segments.size(), 0);
+	while (true) {
+		uint32_t term_id = UINT32_MAX;
+		bool has_terms = false;
+		for (size_t i = 0; i < segments.size(); ++i) {
+			if (positions[i] < segments[i]->term_ids_.size()) {
+				term_id = min(term_id, segments[i]->term_ids_[positions[i]]);
+				has_terms = true;
+			}
+		}
+		if (!has_terms) {
+			break;
+		}
+		for (size_t i = 0; i < segments.size(); ++i) {
+			const size_t position = positions[i];
+			if (position < segments[i]->term_ids_.size() && segments[i]->term_ids_[position] == term_id) {
+				const Posting* postings = segments[i]->postings_.data();
+				AppendAlivePostings({ postings + segments[i]->offsets_[position], postings + segments[i]->offsets_[position + 1] }, alive, new_ordinals);
+				++positions[i];
+			}
+		}
+		CloseTerm(term_id);
+	}
+	postings_.shrink_to_fit();
+	term_ids_.shrink_to_fit();
+	offsets_.shrink_to_fit();
+}
+
+PostingList SealedSegment::GetPostings(uint32_t term_id) const {
+	const auto it = lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+	if (it == term_ids_.end() || *it != term_id) {
+		return {};
+	}
+	const size_t index = it - term_ids_.begin();
+	return { postings_.data() + offsets_[index], postings_.data() + offsets_[index + 1] };
+}
+
+size_t SealedSegment::GetPostingCount() const {
+	return postings_.size();
+}
+
+int SealedSegment::GetLevel() const {
+	return level_;
+}
+
+uint32_t SealedSegment::GetFirstOrdinal() const {
+	return first_ordinal_;
+}
+
+uint32_t SealedSegment::GetLastOrdinal() const {
+	return last_ordinal_;
+}
+
+void SealedSegment::AppendAlivePostings(PostingList postings, const DocumentBitmap& alive, const vector<uint32_t>* new_ordinals) {
+	for (const Posting& posting : postings) {
+		if (alive.Test(posting.ordinal)) {
+			postings_.push_back(new_ordinals ? Posting{ (*new_ordinals)[posting.ordinal], posting.term_freq } : posting);
+		}
+	}
+}
+
+void SealedSegment::CloseTerm(uint32_t term_id) {
+	if (postings_.size() > offsets_.back()) {
+		term_ids_.push_back(term_id);
+		offsets_.push_back(static_cast<uint32_t>(postings_.size()));
+	}
+}
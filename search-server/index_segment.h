@@ -0,0 +1,115 @@
+#pragma once
+#include "document_bitmap.h"
+#include "forward_index.h"
+#include "memory_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+struct Posting {
+    uint32_t ordinal;
+    float term_freq;
+};
+
+// Список документов слова в одном сегменте, упорядоченный по внутреннему номеру
+class PostingList {
+public:
+    PostingList() = default;
+    PostingList(const Posting* begin, const Posting* end)
+        : begin_(begin)
+        , end_(end) {
+    }
+
+    const Posting* begin() const {
+        return begin_;
+    }
+    const Posting* end() const {
+        return end_;
+    }
+    size_t size() const {
+        return end_ - begin_;
+    }
+
+    // Первая запись с номером не меньше ordinal
+    const Posting* LowerBound(uint32_t ordinal) const;
+    // Запись документа или nullptr
+    const Posting* Find(uint32_t ordinal) const;
+
+private:
+    const Posting* begin_ = nullptr;
+    const Posting* end_ = nullptr;
+};
+
+// Изменяемый сегмент, в который попадают новые документы. Номера документов
+// выдаются по возрастанию, поэтому дописывание в конец списков сохраняет их порядок.
+class MutableSegment {
+public:
+    explicit MutableSegment(MemoryCounter* counter = nullptr);
+
+    void AddDocument(uint32_t ordinal, const std::vector<TermFrequency>& entries);
+    void Clear();
+
+    PostingList GetPostings(uint32_t term_id) const;
+    size_t GetDocumentCount() const;
+    bool empty() const;
+
+    uint32_t GetFirstOrdinal() const;
+    uint32_t GetLastOrdinal() const;
+
+    // function(term_id, PostingList) в порядке возрастания term id
+    template <typename Function>
+    void ForEachTerm(Function function) const;
+
+private:
+    using Postings = std::vector<Posting, CountingAllocator<Posting>>;
+
+    MemoryCounter* counter_;
+    std::map<uint32_t, Postings, std::less<uint32_t>, CountingAllocator<std::pair<const uint32_t, Postings>>> postings_;
+    size_t document_count_ = 0;
+    uint32_t first_ordinal_ = 0;
+    uint32_t last_ordinal_ = 0;
+};
+
+// Неизменяемый сегмент: списки документов всех слов лежат подряд в одном
+// массиве, каталог слов упорядочен по term id. Сегмент покрывает диапазон
+// номеров [GetFirstOrdinal(), GetLastOrdinal()), диапазоны сегментов не пересекаются.
+// Уровень - число слияний, через которые прошли документы сегмента.
+class SealedSegment {
+public:
+    // Записи удалённых документов при запечатывании и слиянии отбрасываются
+    SealedSegment(const MutableSegment& segment, const DocumentBitmap& alive, MemoryCounter* counter);
+    // Слияние соседних сегментов, перечисленных в порядке номеров документов.
+    // Если задан new_ordinals из DocumentIdTable::Renumber, документы получают новые номера
+    SealedSegment(const std::vector<std::shared_ptr<const SealedSegment>>& segments, const DocumentBitmap& alive,
+        int level, MemoryCounter* counter, const std::vector<uint32_t>* new_ordinals = nullptr);
+
+    PostingList GetPostings(uint32_t term_id) const;
+    size_t GetPostingCount() const;
+    int GetLevel() const;
+
+    uint32_t GetFirstOrdinal() const;
+    uint32_t GetLastOrdinal() const;
+
+private:
+    std::vector<uint32_t, CountingAllocator<uint32_t>> term_ids_;
+    // Списки слова term_ids_[i] занимают [offsets_[i], offsets_[i + 1])
+    std::vector<uint32_t, CountingAllocator<uint32_t>> offsets_;
+    std::vector<Posting, CountingAllocator<Posting>> postings_;
+    int level_ = 0;
+    uint32_t first_ordinal_ = 0;
+    uint32_t last_ordinal_ = 0;
+
+    void AppendAlivePostings(PostingList postings, const DocumentBitmap& alive, const std::vector<uint32_t>* new_ordinals = nullptr);
+    // Закрывает список слова, если в него попала хоть одна запись
+    void CloseTerm(uint32_t term_id);
+};
+
+template <typename Function>
+void MutableSegment::ForEachTerm(Function function) const {
+    for (const auto& [term_id, postings] : postings_) {
+        function(term_id, PostingList(postings.data(), postings.data() + postings.size()));
+    }
+}
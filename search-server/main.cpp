@@ -5,13 +5,40 @@
 #include "remove_duplicates.h"
 #include "test_example_functions.h"
 #include "process_queries.h"
+#include "corpus_loader.h"
+#include "durable_search_server.h"
 
 #include <random>
 #include <numeric>
 #include <list>
+#include <filesystem>
+#include <fstream>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
 
 using namespace std;
 
+// Счётчик выделений памяти, чтобы проверить, сколько их приходится на один запрос
+atomic<size_t> allocation_count{ 0 };
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void* pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
 string GenerateWord(mt19937& generator, int max_length) {
     const int length = uniform_int_distribution(1, max_length)(generator);
     string word;
@@ -67,13 +94,265 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
     cout << total_relevance << endl;
 }
 
+// Первый проход прогревает буферы, выделения считаются во втором
+template <typename Search>
+void TestAllocations(string_view mark, const vector<string>& queries, Search search) {
+    for (const string_view query : queries) {
+        search(query);
+    }
+    LOG_DURATION(mark);
+    const size_t start_count = allocation_count.load();
+    for (const string_view query : queries) {
+        search(query);
+    }
+    cout << static_cast<double>(allocation_count.load() - start_count) / queries.size() << " allocations per query"s << endl;
+}
+
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+#define TEST_POLICY(policy) Test(#policy, search_server, queries, policy)
+
+template <typename Filter>
+void TestFilter(string_view mark, const SearchServer& search_server, const vector<string>& queries, const Filter& filter) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(query, filter)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+
+
+template <typename Process>
+void TestProcessQueries(string_view mark, const SearchServer& search_server, const vector<string>& queries, Process process) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const auto& documents : process(search_server, queries)) {
+        for (const auto& document : documents) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+template <typename Count>
+void TestCount(string_view mark, const vector<string>& queries, Count count) {
+    LOG_DURATION(mark);
+    size_t total_count = 0;
+    for (const string_view query : queries) {
+        total_count += count(query);
+    }
+    cout << total_count << endl;
+}
+
+// Проверки новых путей поиска против FindTopDocuments и MatchDocument.
+// При расхождении программа завершается с описанием проверки
+void Check(bool condition, string_view description) {
+    if (!condition) {
+        cerr << "Check failed: "s << description << endl;
+        abort();
+    }
+}
+
+bool AreEqual(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& l, const Document& r) {
+        return l.id == r.id && abs(l.relevance - r.relevance) < EPSILON && l.rating == r.rating;
+        });
+}
+
+template <typename Function>
+bool ThrowsInvalidArgument(Function function) {
+    try {
+        function();
+    }
+    catch (const invalid_argument&) {
+        return true;
+    }
+    return false;
+}
 
+// Фильтр, скомпилированный в битовую карту, отбирает те же документы, что и предикат
+void TestDocumentFilter(const SearchServer& search_server, const vector<string>& queries) {
+    for (const string& query : queries) {
+        for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            const auto document_status = static_cast<DocumentStatus>(status);
+            const auto by_predicate = search_server.FindTopDocuments(query, [document_status](int, DocumentStatus status, int) {
+                return status == document_status;
+                });
+            Check(AreEqual(search_server.FindTopDocuments(query, DocumentFilter(document_status)), by_predicate), "status filter"s);
+            Check(AreEqual(search_server.FindTopDocuments(execution::par, query, DocumentFilter(document_status)), by_predicate), "parallel status filter"s);
+        }
+        Check(AreEqual(search_server.FindTopDocuments(query, DocumentFilter(DocumentStatus::ACTUAL).SetRatingRange(2, 4)),
+            search_server.FindTopDocuments(query, [](int, DocumentStatus status, int rating) {
+                return status == DocumentStatus::ACTUAL && rating >= 2 && rating <= 4;
+                })), "rating filter"s);
+        Check(AreEqual(search_server.FindTopDocuments(query, DocumentFilter().SetIds({ 1, 2, 3, 5, 8, 13, 21, 34, 55, 89 })),
+            search_server.FindTopDocuments(query, [](int document_id, DocumentStatus, int) {
+                return document_id == 1 || document_id == 2 || document_id == 3 || document_id == 5 || document_id == 8
+                    || document_id == 13 || document_id == 21 || document_id == 34 || document_id == 55 || document_id == 89;
+                })), "id filter"s);
+    }
+}
+
+// Поиск с буферами потока и с буфером результата вызывающего совпадает с обычным
+void TestQueryContextReuse(const SearchServer& search_server, const vector<string>& queries) {
+    vector<Document> result;
+    for (const string& query : queries) {
+        search_server.FindTopDocuments(query, DocumentFilter(DocumentStatus::ACTUAL), result);
+        Check(AreEqual(result, search_server.FindTopDocuments(query)), "caller result buffer"s);
+    }
+    vector<vector<Document>> parallel_results(queries.size());
+    transform(execution::par, queries.begin(), queries.end(), parallel_results.begin(), [&search_server](const string& query) {
+        vector<Document> documents;
+        search_server.FindTopDocuments(query, DocumentFilter(DocumentStatus::ACTUAL), documents);
+        return documents;
+        });
+    for (size_t i = 0; i < queries.size(); ++i) {
+        Check(AreEqual(parallel_results[i], search_server.FindTopDocuments(queries[i])), "query buffers of concurrent threads"s);
+    }
+}
+
+// Подсчёт без ранжирования сверяется с перебором документов через MatchDocument
+void TestCountMatches(const SearchServer& search_server, const vector<string>& queries) {
+    for (const string& query : queries) {
+        size_t expected_count = 0;
+        for (const int document_id : search_server) {
+            const auto [words, status] = search_server.MatchDocument(query, document_id);
+            expected_count += status == DocumentStatus::ACTUAL && !words.empty();
+        }
+        Check(search_server.CountMatches(query) == expected_count, "CountMatches"s);
+        Check(search_server.AnyMatch(query) == (expected_count > 0), "AnyMatch"s);
+        Check(search_server.AnyMatch(query) == !search_server.FindTopDocuments(query).empty(), "AnyMatch and FindTopDocuments"s);
+        // Индекс меньше MATCH_ESTIMATE_MIN_DOCUMENTS считается без выборки
+        Check(search_server.EstimateMatches(query) == expected_count, "EstimateMatches on a small index"s);
+    }
+}
+
+void TestBatch(const SearchServer& search_server, const vector<string>& queries) {
+    const auto results = search_server.FindTopDocumentsBatch(queries);
+    const auto banned_results = search_server.FindTopDocumentsBatch(execution::par, queries, DocumentFilter(DocumentStatus::BANNED));
+    Check(results.size() == queries.size() && banned_results.size() == queries.size(), "batch result count"s);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        Check(AreEqual(results[i], search_server.FindTopDocuments(queries[i])), "batch"s);
+        Check(AreEqual(banned_results[i], search_server.FindTopDocuments(queries[i], DocumentStatus::BANNED)), "batch with filter"s);
+    }
+    const auto batched = ProcessQueriesBatched(search_server, queries);
+    const auto per_query = ProcessQueries(search_server, queries);
+    Check(equal(batched.begin(), batched.end(), per_query.begin(), per_query.end(), AreEqual), "ProcessQueriesBatched"s);
+}
+
+// Страницы по курсору, склеенные вместе, - полная выдача в порядке FindTopDocuments
+void TestPagination(const SearchServer& search_server, const vector<string>& queries) {
+    for (const string& query : queries) {
+        const size_t match_count = search_server.CountMatches(query);
+        for (const size_t page_size : { size_t{ 1 }, size_t{ 3 }, static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT) }) {
+            vector<Document> documents;
+            SearchCursor cursor;
+            while (true) {
+                const auto page = search_server.FindTopDocumentsAfter(query, cursor, page_size);
+                documents.insert(documents.end(), page.documents.begin(), page.documents.end());
+                if (!page.next_cursor) {
+                    // Последняя страница пуста, только если пуста вся выдача
+                    Check(!page.documents.empty() || documents.empty(), "no empty last page"s);
+                    break;
+                }
+                Check(page.documents.size() == page_size, "full page before the last one"s);
+                cursor = SearchCursor::FromString(page.next_cursor->ToString());
+            }
+            Check(documents.size() == match_count, "pages cover all matched documents"s);
+            const size_t top_count = min(documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+            Check(AreEqual(vector<Document>(documents.begin(), documents.begin() + top_count), search_server.FindTopDocuments(query)),
+                "first pages match FindTopDocuments"s);
+        }
+    }
+}
+
+// Запросы без плюс-слов ничего не находят ни одним путём, пустой запрос везде - ошибка
+void TestEdgeQueries(const SearchServer& search_server, const vector<string>& empty_result_queries) {
+    for (const string& query : empty_result_queries) {
+        Check(search_server.FindTopDocuments(query).empty(), "empty result"s);
+        Check(search_server.CountMatches(query) == 0 && !search_server.AnyMatch(query), "no matches"s);
+        Check(search_server.FindTopDocumentsBatch({ query }).front().empty(), "empty batch result"s);
+        const auto page = search_server.FindTopDocumentsAfter(query, SearchCursor());
+        Check(page.documents.empty() && !page.next_cursor, "single empty page"s);
+    }
+    const bool throws = ThrowsInvalidArgument([&search_server] { search_server.FindTopDocuments(""s); });
+    Check(ThrowsInvalidArgument([&search_server] { search_server.CountMatches(""s); }) == throws, "empty query in CountMatches"s);
+    Check(ThrowsInvalidArgument([&search_server] { search_server.FindTopDocumentsAfter(""s, SearchCursor()); }) == throws,
+        "empty query in FindTopDocumentsAfter"s);
+    Check(ThrowsInvalidArgument([&search_server] { search_server.FindTopDocumentsBatch({ ""s }); }) == throws, "empty query in batch"s);
+}
+
+void TestRemovedDocuments(const SearchServer& search_server, const vector<string>& queries, const vector<int>& removed_ids) {
+    for (const int document_id : removed_ids) {
+        bool thrown = false;
+        try {
+            search_server.MatchDocument(queries.front(), document_id);
+        }
+        catch (const out_of_range&) {
+            thrown = true;
+        }
+        Check(thrown, "MatchDocument of a removed document"s);
+    }
+    const DocumentFilter removed_filter = DocumentFilter().SetIds(removed_ids);
+    for (const string& query : queries) {
+        Check(search_server.FindTopDocuments(query, removed_filter).empty(), "removed documents are not found"s);
+        Check(search_server.CountMatches(query, removed_filter) == 0, "removed documents are not counted"s);
+    }
+}
+
+// Слияние сегментов в Compact не меняет выдачу: она совпадает с сервером, построенным заново
+void TestSegmentMerge(SearchServer& search_server, const SearchServer& rebuilt_server, const vector<string>& queries) {
+    vector<vector<Document>> before_merge;
+    for (const string& query : queries) {
+        before_merge.push_back(search_server.FindTopDocuments(query));
+    }
+    search_server.Compact();
+    Check(search_server.GetMemoryStats().segment_count <= 1, "segments merged"s);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto after_merge = search_server.FindTopDocuments(queries[i]);
+        Check(AreEqual(after_merge, before_merge[i]), "results before and after merge"s);
+        Check(AreEqual(after_merge, rebuilt_server.FindTopDocuments(queries[i])), "results of a rebuilt server"s);
+    }
+}
 
+void TestCountingAllocator() {
+    MemoryCounter counter;
+    {
+        vector<int, CountingAllocator<int>> numbers{ CountingAllocator<int>(&counter) };
+        numbers.reserve(100);
+        Check(counter.GetBytes() == 100 * sizeof(int), "allocated bytes"s);
+        auto copy = numbers;
+        copy.reserve(200);
+        Check(counter.GetBytes() == 300 * sizeof(int), "copy shares the counter"s);
+    }
+    Check(counter.GetBytes() == 0, "deallocated bytes"s);
+
+    SearchServer search_server("and"s);
+    for (int id = 0; id < 100; ++id) {
+        search_server.AddDocument(id, "document number "s + to_string(id) + " with a long enough text to leave the small string buffer"s,
+            DocumentStatus::ACTUAL, { id });
+    }
+    const MemoryStats full = search_server.GetMemoryStats();
+    Check(full.document_count == 100 && full.document_texts > 0 && full.postings > 0, "memory of added documents"s);
+    for (int id = 0; id < 100; ++id) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.Compact();
+    const MemoryStats empty = search_server.GetMemoryStats();
+    Check(empty.document_count == 0 && empty.document_texts == 0 && empty.GetTotal() < full.GetTotal(), "memory after removal"s);
+}
 
 int main()
 {
     mt19937 generator;
+    {
+        LOG_DURATION("calibration"s);
+        SetExecutionThresholds(CalibrateExecutionThresholds());
+        const auto& thresholds = GetExecutionThresholds();
+        cout << "parallel from "s << thresholds.parallel_min_postings << " postings, shards from "s << thresholds.shard_min_postings
+            << " postings"s << endl;
+    }
     {
         SearchServer search_server("and with"s);
 
@@ -106,6 +385,72 @@ int main()
         for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
             PrintDocument(document);
         }
+
+        cout << "Prefix query:"s << endl;
+        // слова вида prefix* заменяются словами индекса с этим началом
+        for (const Document& document : search_server.FindTopDocuments("cur* -ye*"s)) {
+            PrintDocument(document);
+        }
+
+        // постраничная выдача по курсору
+        SearchCursor cursor;
+        for (int page_number = 1; ; ++page_number) {
+            const auto page = search_server.FindTopDocumentsAfter("curly nasty cat"s, cursor, 3);
+            cout << "Page "s << page_number << ":"s << endl;
+            for (const Document& document : page.documents) {
+                PrintDocument(document);
+            }
+            if (!page.next_cursor) {
+                break;
+            }
+            cursor = *page.next_cursor;
+        }
+    }
+
+    {
+        // Новые пути поиска сверяются с FindTopDocuments и MatchDocument на индексе с удалёнными документами
+        const auto dictionary = GenerateDictionary(generator, 300, 6);
+        const auto documents = GenerateQueries(generator, dictionary, 3'000, 20);
+
+        SearchServer search_server(dictionary[0]);
+        SearchServer rebuilt_server(dictionary[0]);
+        vector<int> removed_ids;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            const int id = static_cast<int>(i);
+            const auto status = static_cast<DocumentStatus>(i % DOCUMENT_STATUS_COUNT);
+            search_server.AddDocument(id, documents[i], status, { id % 7 });
+            if (i % 7 == 3) {
+                removed_ids.push_back(id);
+            }
+            else {
+                rebuilt_server.AddDocument(id, documents[i], status, { id % 7 });
+            }
+        }
+        for (const int id : removed_ids) {
+            search_server.RemoveDocument(id);
+        }
+
+        vector<string> queries;
+        for (int i = 0; i < 50; ++i) {
+            queries.push_back(GenerateQuery(generator, dictionary, 1 + i % 5, 0.2));
+        }
+        queries.push_back(dictionary[1].substr(0, 1) + "*"s);
+        const vector<string> empty_result_queries = {
+            dictionary[0],
+            "-"s + dictionary[1] + " -"s + dictionary[2],
+            "nonexistentword"s,
+        };
+
+        TestDocumentFilter(search_server, queries);
+        TestQueryContextReuse(search_server, queries);
+        TestCountMatches(search_server, queries);
+        TestBatch(search_server, queries);
+        TestPagination(search_server, queries);
+        TestEdgeQueries(search_server, empty_result_queries);
+        TestRemovedDocuments(search_server, queries, removed_ids);
+        TestSegmentMerge(search_server, rebuilt_server, queries);
+        TestCountingAllocator();
+        cout << "Checks passed"s << endl;
     }
 
     {
@@ -121,5 +466,210 @@ int main()
 
         TEST(seq);
         TEST(par);
+        TEST_POLICY(SHARD_PARALLEL_POLICY);
+        TEST_POLICY(ADAPTIVE_POLICY);
+
+        const auto short_queries = GenerateQueries(generator, dictionary, 10'000, 2);
+        Test("short seq"s, search_server, short_queries, execution::seq);
+        Test("short par"s, search_server, short_queries, execution::par);
+        Test("short adaptive"s, search_server, short_queries, ADAPTIVE_POLICY);
+
+        TestAllocations("short returned result"s, short_queries, [&search_server](string_view query) {
+            search_server.FindTopDocuments(query);
+            });
+        vector<Document> result;
+        TestAllocations("short caller buffer"s, short_queries, [&search_server, &result](string_view query) {
+            search_server.FindTopDocuments(query, DocumentFilter(DocumentStatus::ACTUAL), result);
+            });
+
+        cout << search_server.GetMemoryStats() << endl;
+    }
+
+    {
+        // Избирательный фильтр: забанен лишь каждый сотый документ
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            const auto status = i % 100 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            search_server.AddDocument(i, documents[i], status, { 1, 2, 3 });
+        }
+
+        const auto queries = GenerateQueries(generator, dictionary, 100, 70);
+
+        TestFilter("BANNED lambda"s, search_server, queries, [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::BANNED;
+            });
+        TestFilter("BANNED filter"s, search_server, queries, DocumentFilter(DocumentStatus::BANNED));
+        TestFilter("rating filter"s, search_server, queries, DocumentFilter(DocumentStatus::ACTUAL).SetRatingRange(2, 2));
+    }
+
+    {
+        // Пакетная обработка: запросы составлены из популярных слов и делят их списки документов
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+        const vector<string> popular_words(dictionary.begin(), dictionary.begin() + 50);
+
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+        for (const int query_count : { 1'000, 10'000, 100'000 }) {
+            const auto queries = GenerateQueries(generator, popular_words, query_count, 3);
+            TestProcessQueries("per-query "s + to_string(query_count), search_server, queries, ProcessQueries);
+            TestProcessQueries("batched "s + to_string(query_count), search_server, queries, ProcessQueriesBatched);
+        }
+    }
+
+    {
+        // Популярные запросы из одного-двух частых слов: ответ по упорядоченным спискам против полного обхода
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const vector<string> popular_words(dictionary.begin(), dictionary.begin() + 100);
+        const auto documents = GenerateQueries(generator, popular_words, 10'000, 70);
+
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+        auto queries = GenerateQueries(generator, popular_words, 5'000, 1);
+        const auto pair_queries = GenerateQueries(generator, popular_words, 5'000, 2);
+        queries.insert(queries.end(), pair_queries.begin(), pair_queries.end());
+        // Запросы только считают слова, списки строятся отдельным обновлением
+        for (const string& query : queries) {
+            search_server.FindTopDocuments(query);
+        }
+        search_server.UpdateHotTerms();
+
+        TestFilter("hot terms lambda"s, search_server, queries, [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL;
+            });
+        TestFilter("hot terms filter"s, search_server, queries, DocumentFilter(DocumentStatus::ACTUAL));
+    }
+
+    {
+        // Подсчёт без ранжирования: сколько документов найдено и найдено ли хоть что-то
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, 200'000, 10);
+
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+        const auto queries = GenerateQueries(generator, dictionary, 1'000, 3);
+
+        TestCount("top documents found"s, queries, [&search_server](string_view query) {
+            return search_server.FindTopDocuments(query).empty() ? 0 : 1;
+            });
+        TestCount("any match"s, queries, [&search_server](string_view query) {
+            return search_server.AnyMatch(query) ? 1 : 0;
+            });
+        TestCount("count matches"s, queries, [&search_server](string_view query) {
+            return search_server.CountMatches(query);
+            });
+        TestCount("estimate matches"s, queries, [&search_server](string_view query) {
+            return search_server.EstimateMatches(query);
+            });
+    }
+
+    {
+        // Поток обновлений: документы заменяются, между заменами идут запросы
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+        const auto updates = GenerateQueries(generator, dictionary, 20'000, 70);
+        const auto queries = GenerateQueries(generator, dictionary, 2'000, 5);
+
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+        {
+            LOG_DURATION("update stream"s);
+            double total_relevance = 0;
+            int next_id = static_cast<int>(documents.size());
+            for (size_t i = 0; i < updates.size(); ++i) {
+                search_server.RemoveDocument(next_id - static_cast<int>(documents.size()));
+                search_server.AddDocument(next_id++, updates[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+                if (i % 10 == 0) {
+                    for (const auto& document : search_server.FindTopDocuments(queries[i / 10])) {
+                        total_relevance += document.relevance;
+                    }
+                }
+            }
+            cout << total_relevance << endl;
+        }
+        cout << search_server.GetMemoryStats() << endl;
+    }
+
+    {
+        // загрузка корпуса из файла через отображение в память
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, 100'000, 70);
+        const auto corpus_path = (filesystem::temp_directory_path() / "search_server_corpus.txt"s).string();
+        {
+            ofstream corpus(corpus_path);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                corpus << i << '\t' << (i % 100 == 0 ? "BANNED"s : "ACTUAL"s) << '\t' << "1 2 3"s << '\t' << documents[i] << '\n';
+            }
+        }
+
+        SearchServer search_server(dictionary[0]);
+        cout << LoadCorpus(search_server, corpus_path) << endl;
+        filesystem::remove(corpus_path);
+    }
+
+    {
+        // Журнал изменений: добавление без журнала, с групповой фиксацией и с fsync на каждую запись
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, 20'000, 70);
+        const auto directory = (filesystem::temp_directory_path() / "search_server_wal"s).string();
+        filesystem::remove_all(directory);
+        const size_t half = documents.size() / 2;
+        {
+            SearchServer search_server(dictionary[0]);
+            LOG_DURATION("in-memory ingest"s);
+            for (size_t i = 0; i < half; ++i) {
+                search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+            }
+        }
+        {
+            SearchServer search_server(dictionary[0]);
+            DurableSearchServer durable_server(search_server, directory, WalSyncMode::GROUP);
+            {
+                LOG_DURATION("durable group ingest"s);
+                for (size_t i = 0; i < half; ++i) {
+                    durable_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+                }
+                durable_server.Sync();
+            }
+            {
+                LOG_DURATION("checkpoint"s);
+                durable_server.Checkpoint();
+            }
+            {
+                // Каждый писатель ждёт fsync своей записи, одновременные записи делят один fsync
+                const size_t writer_count = 8;
+                LOG_DURATION("durable each-write ingest, 8 writers"s);
+                vector<thread> writers;
+                for (size_t writer = 0; writer < writer_count; ++writer) {
+                    writers.emplace_back([&, writer] {
+                        for (size_t i = half + writer; i < documents.size(); i += writer_count) {
+                            durable_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+                        }
+                        });
+                }
+                for (auto& writer : writers) {
+                    writer.join();
+                }
+            }
+        }
+        {
+            SearchServer search_server(dictionary[0]);
+            LOG_DURATION("recovery"s);
+            const DurableSearchServer durable_server(search_server, directory);
+            cout << search_server.GetDocumentCount() << " documents, "s
+                << durable_server.GetRecoveryStats().record_count << " log records"s << endl;
+        }
+        filesystem::remove_all(directory);
     }
 }
@@ -0,0 +1,71 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const string& path) {
+	ifstream input(path, ios::binary);
+	if (!input) {
+		throw runtime_error("Cannot open file "s + path);
+	}
+	ostringstream content;
+	content << input.rdbuf();
+	buffer_ = content.str();
+}
+
+MappedFile::~MappedFile() = default;
+
+string_view MappedFile::GetData() const {
+	return buffer_;
+}
+
+#else
+
+MappedFile::MappedFile(const string& path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw runtime_error("Cannot open file "s + path);
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		throw runtime_error("Cannot stat file "s + path);
+	}
+	size_ = static_cast<size_t>(file_stat.st_size);
+	if (size_ > 0) {
+		data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data_ == MAP_FAILED) {
+			data_ = nullptr;
+			close(fd);
+			throw runtime_error("Cannot map file "s + path);
+		}
+		// Файл читается от начала к концу, ядру выгодно читать вперёд
+		madvise(data_, size_, MADV_SEQUENTIAL);
+	}
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (data_) {
+		munmap(data_, size_);
+	}
+}
+
+string_view MappedFile::GetData() const {
+	return { static_cast<const char*>(data_), size_ };
+}
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Файл, отображённый в память только для чтения.
+// Там, где отображение недоступно, содержимое файла читается в буфер.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view GetData() const;
+
+private:
+#if defined(_WIN32)
+    std::string buffer_;
+#else
+    void* data_ = nullptr;
+    size_t size_ = 0;
+#endif
+};
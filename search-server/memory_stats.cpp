@@ -0,0 +1,22 @@
+#include "memory_stats.h"
+
+using namespace std;
+
+size_t MemoryStats::GetTotal() const {
+	return document_texts + term_dictionary + postings + forward_index + metadata;
+}
+
+ostream& operator << (ostream& output, const MemoryStats& stats) {
+    output << "{ "s
+        << "document_texts = "s << stats.document_texts << ", "s
+        << "term_dictionary = "s << stats.term_dictionary << ", "s
+        << "postings = "s << stats.postings << ", "s
+        << "forward_index = "s << stats.forward_index << ", "s
+        << "metadata = "s << stats.metadata << ", "s
+        << "total = "s << stats.GetTotal() << ", "s
+        << "documents = "s << stats.document_count << ", "s
+        << "terms = "s << stats.term_count << ", "s
+        << "postings_count = "s << stats.posting_count << ", "s
+        << "segments = "s << stats.segment_count << " }"s;
+    return output;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+// Счётчик байт, выделенных через CountingAllocator
+class MemoryCounter {
+public:
+    void Allocate(size_t bytes) {
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void Deallocate(size_t bytes) {
+        bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    size_t GetBytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> bytes_{ 0 };
+};
+
+// Аллокатор, учитывающий выделенную память в счётчике.
+// Аллокатор без счётчика ведёт себя как std::allocator.
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+
+    CountingAllocator() noexcept = default;
+    explicit CountingAllocator(MemoryCounter* counter) noexcept
+        : counter_(counter) {
+    }
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.GetCounter()) {
+    }
+
+    T* allocate(size_t n) {
+        T* result = std::allocator<T>().allocate(n);
+        if (counter_) {
+            counter_->Allocate(n * sizeof(T));
+        }
+        return result;
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        if (counter_) {
+            counter_->Deallocate(n * sizeof(T));
+        }
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    MemoryCounter* GetCounter() const noexcept {
+        return counter_;
+    }
+
+private:
+    MemoryCounter* counter_ = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+using TrackedString = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+
+struct MemoryStats {
+    size_t document_texts = 0;
+    size_t term_dictionary = 0;
+    size_t postings = 0;
+    size_t forward_index = 0;
+    size_t metadata = 0;
+
+    size_t document_count = 0;
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    size_t segment_count = 0;
+
+    size_t GetTotal() const;
+};
+
+std::ostream& operator << (std::ostream& output, const MemoryStats& stats);
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
 
 template <typename It>
@@ -33,7 +34,7 @@ public:
     Paginator(It begin, It end, size_t page_size)
     {
         for (size_t range_size = distance(begin, end);range_size > 0;) {
-            const size_t current_page_size = min(page_size, range_size);
+            const size_t current_page_size = std::min(page_size, range_size);
             const It current_page_end = next(begin, current_page_size);
             pages_.push_back({ begin, current_page_end });
             range_size -= current_page_size;
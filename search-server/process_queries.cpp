@@ -15,6 +15,13 @@ std::vector<std::vector<Document>> ProcessQueries(
     return res;
 }
 
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
+}
+
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries)
 {
     auto queries_to_documents = ProcessQueries(search_server, queries);
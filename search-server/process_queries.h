@@ -7,5 +7,11 @@ std::vector<std::vector<Document>> ProcessQueries(
     const std::vector<std::string>& queries);
 
 std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Пакетная обработка: списки документов слов, общих для нескольких запросов,
+// обходятся один раз на группу запросов. Результаты совпадают с ProcessQueries
+std::vector<std::vector<Document>> ProcessQueriesBatched(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "query_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+template <typename T>
+void PutValue(string& output, T value) {
+	char bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T));
+	output.append(bytes, sizeof(T));
+}
+
+void PutString(string& output, string_view text) {
+	PutValue(output, static_cast<uint32_t>(text.size()));
+	output.append(text);
+}
+
+template <typename T>
+T GetValue(string_view& input) {
+	if (input.size() < sizeof(T)) {
+		throw invalid_argument("Truncated frame"s);
+	}
+	T value;
+	memcpy(&value, input.data(), sizeof(T));
+	input.remove_prefix(sizeof(T));
+	return value;
+}
+
+string_view GetString(string_view& input) {
+	const uint32_t size = GetValue<uint32_t>(input);
+	if (input.size() < size) {
+		throw invalid_argument("Truncated frame"s);
+	}
+	const string_view text = input.substr(0, size);
+	input.remove_prefix(size);
+	return text;
+}
+
+DocumentStatus GetStatus(string_view& input) {
+	const uint8_t status = GetValue<uint8_t>(input);
+	if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+		throw invalid_argument("Invalid document status"s);
+	}
+	return static_cast<DocumentStatus>(status);
+}
+
+QueryType GetType(string_view& input) {
+	const uint8_t type = GetValue<uint8_t>(input);
+	if (type != static_cast<uint8_t>(QueryType::FIND_TOP_DOCUMENTS) && type != static_cast<uint8_t>(QueryType::MATCH_DOCUMENT)) {
+		throw invalid_argument("Invalid request type"s);
+	}
+	return static_cast<QueryType>(type);
+}
+
+// Резервирует место под длину тела; возвращает начало кадра
+size_t BeginFrame(string& output, uint32_t request_id, QueryType type) {
+	const size_t frame_start = output.size();
+	PutValue(output, uint32_t{ 0 });
+	PutValue(output, request_id);
+	PutValue(output, static_cast<uint8_t>(type));
+	return frame_start;
+}
+
+void EndFrame(string& output, size_t frame_start) {
+	const uint32_t body_size = static_cast<uint32_t>(output.size() - frame_start - sizeof(uint32_t));
+	memcpy(&output[frame_start], &body_size, sizeof(body_size));
+}
+
+void CheckFullyParsed(string_view body) {
+	if (!body.empty()) {
+		throw invalid_argument("Unexpected data at the end of frame"s);
+	}
+}
+
+}  // namespace
+
+void AppendFindRequest(string& output, uint32_t request_id, string_view query, DocumentStatus status) {
+	const size_t frame_start = BeginFrame(output, request_id, QueryType::FIND_TOP_DOCUMENTS);
+	PutValue(output, static_cast<uint8_t>(status));
+	PutString(output, query);
+	EndFrame(output, frame_start);
+}
+
+void AppendMatchRequest(string& output, uint32_t request_id, string_view query, int document_id) {
+	const size_t frame_start = BeginFrame(output, request_id, QueryType::MATCH_DOCUMENT);
+	PutValue(output, static_cast<int32_t>(document_id));
+	PutString(output, query);
+	EndFrame(output, frame_start);
+}
+
+void AppendFindResponse(string& output, uint32_t request_id, const vector<Document>& documents) {
+	const size_t frame_start = BeginFrame(output, request_id, QueryType::FIND_TOP_DOCUMENTS);
+	PutValue(output, uint8_t{ 1 });
+	PutValue(output, static_cast<uint32_t>(documents.size()));
+	for (const Document& document : documents) {
+		PutValue(output, static_cast<int32_t>(document.id));
+		PutValue(output, document.relevance);
+		PutValue(output, static_cast<int32_t>(document.rating));
+	}
+	EndFrame(output, frame_start);
+}
+
+void AppendMatchResponse(string& output, uint32_t request_id, const vector<string_view>& words, DocumentStatus status) {
+	const size_t frame_start = BeginFrame(output, request_id, QueryType::MATCH_DOCUMENT);
+	PutValue(output, uint8_t{ 1 });
+	PutValue(output, static_cast<uint8_t>(status));
+	PutValue(output, static_cast<uint32_t>(words.size()));
+	for (const string_view word : words) {
+		PutString(output, word);
+	}
+	EndFrame(output, frame_start);
+}
+
+void AppendErrorResponse(string& output, uint32_t request_id, QueryType type, string_view message) {
+	const size_t frame_start = BeginFrame(output, request_id, type);
+	PutValue(output, uint8_t{ 0 });
+	PutString(output, message);
+	EndFrame(output, frame_start);
+}
+
+size_t GetFrameSize(string_view input) {
+	if (input.size() < sizeof(uint32_t)) {
+		return 0;
+	}
+	const size_t body_size = GetValue<uint32_t>(input);
+	if (body_size > MAX_QUERY_FRAME_SIZE) {
+		throw invalid_argument("Frame is too long"s);
+	}
+	return input.size() < body_size ? 0 : sizeof(uint32_t) + body_size;
+}
+
+void ParseRequest(string_view frame, QueryRequest& request) {
+	string_view body = frame.substr(sizeof(uint32_t));
+	request.request_id = GetValue<uint32_t>(body);
+	request.type = GetType(body);
+	if (request.type == QueryType::FIND_TOP_DOCUMENTS) {
+		request.status = GetStatus(body);
+	}
+	else {
+		request.document_id = GetValue<int32_t>(body);
+	}
+	request.query = GetString(body);
+	CheckFullyParsed(body);
+}
+
+void ParseResponse(string_view frame, QueryResponse& response) {
+	string_view body = frame.substr(sizeof(uint32_t));
+	response.request_id = GetValue<uint32_t>(body);
+	response.type = GetType(body);
+	response.is_ok = GetValue<uint8_t>(body) != 0;
+	response.documents.clear();
+	response.words.clear();
+	response.error = {};
+	if (!response.is_ok) {
+		response.error = GetString(body);
+	}
+	else if (response.type == QueryType::FIND_TOP_DOCUMENTS) {
+		const uint32_t document_count = GetValue<uint32_t>(body);
+		for (uint32_t i = 0; i < document_count; ++i) {
+			const int id = GetValue<int32_t>(body);
+			const double relevance = GetValue<double>(body);
+			const int rating = GetValue<int32_t>(body);
+			response.documents.push_back({ id, relevance, rating });
+		}
+	}
+	else {
+		response.status = GetStatus(body);
+		const uint32_t word_count = GetValue<uint32_t>(body);
+		for (uint32_t i = 0; i < word_count; ++i) {
+			response.words.push_back(GetString(body));
+		}
+	}
+	CheckFullyParsed(body);
+}
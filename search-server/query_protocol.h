@@ -0,0 +1,59 @@
+#pragma once
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Двоичный протокол поисковой службы. Кадр: длина тела (uint32), тело.
+// Тело запроса: номер запроса (uint32), тип (uint8), затем
+//   FIND_TOP_DOCUMENTS: статус документов (uint8), длина запроса (uint32), запрос;
+//   MATCH_DOCUMENT: id документа (int32), длина запроса (uint32), запрос.
+// Тело ответа: номер запроса (uint32), тип (uint8), успех (uint8), затем
+//   FIND_TOP_DOCUMENTS: число документов (uint32), документы: id (int32), релевантность (double), рейтинг (int32);
+//   MATCH_DOCUMENT: статус документа (uint8), число слов (uint32), слова: длина (uint32), слово;
+//   ошибка: длина сообщения (uint32), сообщение.
+// Числа хранятся в порядке байт машины: клиент и служба работают на одном компьютере.
+// Клиент может отправить несколько запросов, не дожидаясь ответов; ответы
+// на запросы одного соединения приходят в порядке запросов.
+enum class QueryType : uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+};
+
+const size_t MAX_QUERY_FRAME_SIZE = 1 << 20;
+
+// Строки указывают в разобранный кадр
+struct QueryRequest {
+    uint32_t request_id = 0;
+    QueryType type = QueryType::FIND_TOP_DOCUMENTS;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int document_id = 0;
+    std::string_view query;
+};
+
+struct QueryResponse {
+    uint32_t request_id = 0;
+    QueryType type = QueryType::FIND_TOP_DOCUMENTS;
+    bool is_ok = true;
+    std::vector<Document> documents;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<std::string_view> words;
+    std::string_view error;
+};
+
+void AppendFindRequest(std::string& output, uint32_t request_id, std::string_view query, DocumentStatus status);
+void AppendMatchRequest(std::string& output, uint32_t request_id, std::string_view query, int document_id);
+
+void AppendFindResponse(std::string& output, uint32_t request_id, const std::vector<Document>& documents);
+void AppendMatchResponse(std::string& output, uint32_t request_id, const std::vector<std::string_view>& words, DocumentStatus status);
+void AppendErrorResponse(std::string& output, uint32_t request_id, QueryType type, std::string_view message);
+
+// Длина первого кадра input вместе с длиной тела, если кадр пришёл целиком, иначе 0.
+// Бросает std::invalid_argument, если кадр длиннее MAX_QUERY_FRAME_SIZE
+size_t GetFrameSize(std::string_view input);
+// Разбирают кадр длины GetFrameSize, бросают std::invalid_argument при ошибке формата
+void ParseRequest(std::string_view frame, QueryRequest& request);
+void ParseResponse(std::string_view frame, QueryResponse& response);
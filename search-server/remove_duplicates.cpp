@@ -3,16 +3,19 @@
 void RemoveDuplicates(SearchServer& search_server) {
     
     std::vector<int> ids_for_remove;
-    std::map<std::set<std::string, std::less<>>, int> words_id;
+    std::map<std::vector<std::string>, int> words_id;
 
     for (const int document_id : search_server) {
-        std::set<std::string, std::less<>> words_set;
-        const auto& words_freqs = search_server.GetWordFrequencies(document_id);
-        for (const auto& [word, _] : words_freqs) {
-            words_set.insert(std::string(word));
+        // Слова документа в прямом индексе упорядочены по term id,
+        // поэтому одинаковые наборы слов дают одинаковые векторы
+        std::vector<std::string> words;
+        const auto words_freqs = search_server.GetWordFrequencies(document_id);
+        words.reserve(words_freqs.size());
+        for (auto [word, _] : words_freqs) {
+            words.push_back(std::move(word));
         }
-        if (words_id.count(words_set)==0) {
-            words_id[words_set]= document_id;
+        if (words_id.count(words)==0) {
+            words_id[words]= document_id;
         }
         else {
             ids_for_remove.push_back(document_id);
@@ -16,6 +16,11 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
 	AddRequest(result.size());
 	return result;
 }
+bool RequestQueue::AddMatchRequest(const std::string& raw_query) {
+	const bool found = search_server_.AnyMatch(raw_query);
+	AddRequest(found ? 1 : 0);
+	return found;
+}
 int RequestQueue::GetNoResultRequests() const {
 	return no_results_requests_;
 }
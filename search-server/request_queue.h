@@ -10,6 +10,8 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
+    // Запрос, для которого важно только, есть ли результаты: документы не ранжируются
+    bool AddMatchRequest(const std::string& raw_query);
     int GetNoResultRequests() const;
 private:
     struct QueryResult {
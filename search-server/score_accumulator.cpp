@@ -0,0 +1,105 @@
+#include "score_accumulator.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+void ScoreAccumulator::Reset(uint32_t ordinal_count) {
+	for (const uint32_t block : touched_blocks_) {
+		fill_n(scores_.begin() + block * BLOCK_SIZE, BLOCK_SIZE, 0.0);
+		matched_[block] = 0;
+		block_touched_[block] = 0;
+	}
+	touched_blocks_.clear();
+
+	const size_t block_count = (ordinal_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (matched_.size() < block_count) {
+		scores_.resize(block_count * BLOCK_SIZE);
+		matched_.resize(block_count);
+		block_touched_.resize(block_count);
+	}
+}
+
+vector<pair<uint32_t, double>> ScoreAccumulator::ExtractAll() const {
+	vector<pair<uint32_t, double>> result;
+	ForEachMatched([&result](uint32_t ordinal, double score) {
+		result.push_back({ ordinal, score });
+		});
+	return result;
+}
+
+const vector<pair<uint32_t, double>>& ScoreAccumulator::ExtractTopCandidates(size_t top_count, double epsilon) {
+	candidates_.clear();
+	if (top_count == 0) {
+		return candidates_;
+	}
+	// Минимальная куча лучших top_count оценок: её вершина - текущая граница отсечения
+	best_scores_.clear();
+	double threshold = -numeric_limits<double>::infinity();
+
+	for (const uint32_t block : touched_blocks_) {
+		if (matched_[block] == 0) {
+			continue;
+		}
+		for (uint64_t mask = matched_[block] & CompareBlock(block, threshold); mask != 0; mask &= mask - 1) {
+			const uint32_t ordinal = block * BLOCK_SIZE + CountTrailingZeros(mask);
+			const double score = scores_[ordinal];
+			if (score < threshold) {
+				continue;
+			}
+			candidates_.push_back({ ordinal, score });
+			if (best_scores_.size() < top_count) {
+				best_scores_.push_back(score);
+				push_heap(best_scores_.begin(), best_scores_.end(), greater<double>());
+			}
+			else if (score > best_scores_.front()) {
+				pop_heap(best_scores_.begin(), best_scores_.end(), greater<double>());
+				best_scores_.back() = score;
+				push_heap(best_scores_.begin(), best_scores_.end(), greater<double>());
+			}
+			if (best_scores_.size() == top_count) {
+				threshold = best_scores_.front() - epsilon;
+			}
+		}
+	}
+
+	candidates_.erase(remove_if(candidates_.begin(), candidates_.end(), [threshold](const pair<uint32_t, double>& candidate) {
+		return candidate.second < threshold;
+		}), candidates_.end());
+	return candidates_;
+}
+
+uint64_t ScoreAccumulator::CompareBlock(uint32_t block, double threshold) const {
+	const double* scores = scores_.data() + block * BLOCK_SIZE;
+	uint64_t mask = 0;
+#if defined(__AVX2__)
+	const __m256d bound = _mm256_set1_pd(threshold);
+	for (uint32_t i = 0; i < BLOCK_SIZE; i += 4) {
+		const __m256d values = _mm256_loadu_pd(scores + i);
+		const int lanes = _mm256_movemask_pd(_mm256_cmp_pd(values, bound, _CMP_GE_OQ));
+		mask |= static_cast<uint64_t>(lanes) << i;
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	const __m128d bound = _mm_set1_pd(threshold);
+	for (uint32_t i = 0; i < BLOCK_SIZE; i += 2) {
+		const __m128d values = _mm_loadu_pd(scores + i);
+		const int lanes = _mm_movemask_pd(_mm_cmpge_pd(values, bound));
+		mask |= static_cast<uint64_t>(lanes) << i;
+	}
+#else
+	for (uint32_t i = 0; i < BLOCK_SIZE; ++i) {
+		if (scores[i] >= threshold) {
+			mask |= uint64_t{ 1 } << i;
+		}
+	}
+#endif
+	return mask;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Плотный накопитель релевантности: оценки лежат в массиве double по внутренним
+// номерам документов, найденные документы отмечены битами блоков по 64 номера.
+// Вклады прибавляются по одному (обычная запись по номеру), векторизован только
+// пороговый просмотр в ExtractTopCandidates. Между запросами очищаются только
+// затронутые блоки, поэтому накопитель выгодно переиспользовать.
+class ScoreAccumulator {
+public:
+    static const uint32_t BLOCK_SIZE = 64;
+
+    void Reset(uint32_t ordinal_count);
+
+    void Add(uint32_t ordinal, double contribution) {
+        const uint32_t block = ordinal / BLOCK_SIZE;
+        if (!block_touched_[block]) {
+            block_touched_[block] = 1;
+            touched_blocks_.push_back(block);
+        }
+        scores_[ordinal] += contribution;
+        matched_[block] |= uint64_t{ 1 } << (ordinal % BLOCK_SIZE);
+    }
+
+    void Remove(uint32_t ordinal) {
+        const uint32_t block = ordinal / BLOCK_SIZE;
+        if (block < matched_.size()) {
+            matched_[block] &= ~(uint64_t{ 1 } << (ordinal % BLOCK_SIZE));
+        }
+    }
+
+    // Все найденные документы
+    std::vector<std::pair<uint32_t, double>> ExtractAll() const;
+    // Вызывает function(ordinal, score) для каждого найденного документа
+    template <typename Function>
+    void ForEachMatched(Function function) const;
+
+    // Документы, которые могут попасть в top_count лучших с учётом того, что
+    // оценки в пределах epsilon считаются равными. Пороговое сравнение блоков
+    // векторизовано (AVX2 или SSE2, если доступны при компиляции).
+    // Результат лежит во внутреннем буфере и действителен до следующего вызова
+    const std::vector<std::pair<uint32_t, double>>& ExtractTopCandidates(size_t top_count, double epsilon);
+
+private:
+    std::vector<double> scores_;
+    std::vector<uint64_t> matched_;
+    std::vector<uint8_t> block_touched_;
+    std::vector<uint32_t> touched_blocks_;
+    // Буферы ExtractTopCandidates, переиспользуются между запросами
+    std::vector<std::pair<uint32_t, double>> candidates_;
+    std::vector<double> best_scores_;
+
+    // Маска номеров блока, чья оценка не меньше threshold
+    uint64_t CompareBlock(uint32_t block, double threshold) const;
+
+    static int CountTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctzll(mask);
+#endif
+    }
+};
+
+template <typename Function>
+void ScoreAccumulator::ForEachMatched(Function function) const {
+    for (const uint32_t block : touched_blocks_) {
+        for (uint64_t mask = matched_[block]; mask != 0; mask &= mask - 1) {
+            const uint32_t ordinal = block * BLOCK_SIZE + CountTrailingZeros(mask);
+            function(ordinal, scores_[ordinal]);
+        }
+    }
+}
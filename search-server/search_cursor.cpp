@@ -0,0 +1,52 @@
+#include "search_cursor.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+SearchCursor::SearchCursor(const Document& last_document)
+	: is_start_(false)
+	, last_document_(last_document) {
+}
+
+bool SearchCursor::IsStart() const {
+	return is_start_;
+}
+
+string SearchCursor::ToString() const {
+	if (is_start_) {
+		return {};
+	}
+	// hexfloat сохраняет релевантность без потери точности
+	ostringstream out;
+	out << hexfloat << last_document_.relevance << ':' << last_document_.rating << ':' << last_document_.id;
+	return out.str();
+}
+
+SearchCursor SearchCursor::FromString(string_view text) {
+	if (text.empty()) {
+		return {};
+	}
+	const string buffer(text);
+	const char* pos = buffer.c_str();
+	char* end = nullptr;
+	Document last_document;
+
+	last_document.relevance = strtod(pos, &end);
+	if (end == pos || *end != ':') {
+		throw invalid_argument("Invalid search cursor "s + buffer);
+	}
+	pos = end + 1;
+	last_document.rating = static_cast<int>(strtol(pos, &end, 10));
+	if (end == pos || *end != ':') {
+		throw invalid_argument("Invalid search cursor "s + buffer);
+	}
+	pos = end + 1;
+	last_document.id = static_cast<int>(strtol(pos, &end, 10));
+	if (end == pos || *end != '\0') {
+		throw invalid_argument("Invalid search cursor "s + buffer);
+	}
+	return SearchCursor(last_document);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "document.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Непрозрачная позиция в выдаче: последний отданный документ страницы.
+// Следующая страница начинается с документов, стоящих в выдаче строго после него.
+// Курсор по умолчанию указывает на начало выдачи.
+class SearchCursor {
+public:
+    SearchCursor() = default;
+
+    bool IsStart() const;
+
+    std::string ToString() const;
+    static SearchCursor FromString(std::string_view text);
+
+private:
+    friend class SearchServer;
+
+    explicit SearchCursor(const Document& last_document);
+
+    bool is_start_ = true;
+    Document last_document_;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // Пусто, если страница последняя
+    std::optional<SearchCursor> next_cursor;
+};
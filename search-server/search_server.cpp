@@ -1,5 +1,8 @@
 #include "search_server.h"
 
+#include <functional>
+#include <limits>
+
 using namespace std;
 
 SearchServer::SearchServer(string_view stop_words_text)
@@ -13,134 +16,422 @@ SearchServer::SearchServer(const string& stop_words_text)
 }
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
-	if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+	if ((document_id < 0) || document_ids_.Contains(document_id)) {
 		throw invalid_argument("Invalid document_id"s);
 	}
-	const auto [it, inserted] = documents_.emplace(document_id,
-		DocumentData{ ComputeAverageRating(ratings), status, string(document) });
+	AddDocument(document_id, document, status, ratings, SplitIntoWordsNoStop(document), false);
+}
 
-	const auto words = SplitIntoWordsNoStop(it->second.text);
+void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings,
+	const vector<string_view>& words, bool is_mapped_text) {
+	if ((document_id < 0) || document_ids_.Contains(document_id)) {
+		throw invalid_argument("Invalid document_id"s);
+	}
+	CheckMemoryBudget(is_mapped_text ? 0 : document.size(), words.size());
 
 	const double inv_word_count = 1.0 / words.size();
+	map<uint32_t, double> term_freqs;
 	for (string_view word : words) {
-		word_to_document_freqs_[word][document_id] += inv_word_count;
-		document_to_word_freqs_[document_id][word] += inv_word_count;
+		term_freqs[dictionary_.Add(word)] += inv_word_count;
 	}
 
-	document_ids_.insert(document_id);
+	vector<TermFrequency> entries;
+	entries.reserve(term_freqs.size());
+	for (const auto [term_id, term_freq] : term_freqs) {
+		entries.push_back({ term_id, static_cast<float>(term_freq) });
+	}
+
+	const uint32_t ordinal = document_ids_.Add(document_id);
+	ratings_.push_back(ComputeAverageRating(ratings));
+	statuses_.push_back(status);
+	if (is_mapped_text) {
+		texts_.emplace_back(CountingAllocator<char>(&memory_->document_texts));
+		mapped_texts_.push_back(document);
+	}
+	else {
+		texts_.emplace_back(document, CountingAllocator<char>(&memory_->document_texts));
+		mapped_texts_.emplace_back();
+	}
+	status_bitmaps_[static_cast<int>(status)].Set(ordinal);
+	hot_terms_->AddDocument(ordinal, entries);
+	inverted_index_.AddDocument(ordinal, entries);
+	forward_index_.AddDocument(ordinal, move(entries));
+	UpdateHotTerms();
 }
 
 
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const {
+	return FindTopDocuments(execution::seq, raw_query, filter);
+}
+
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-	return FindTopDocuments(execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-		return document_status == status;
-		});
+	return FindTopDocuments(execution::seq, raw_query, DocumentFilter(status));
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
 	return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+void SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter, vector<Document>& result) const {
+	FindTopDocuments(execution::seq, raw_query, filter, result);
+}
+
+size_t SearchServer::CountMatches(string_view raw_query, const DocumentFilter& filter) const {
+	const QueryContextLease context;
+	ParseQuery(raw_query, context->query, context->words);
+	CompileFilter(filter, context->allowed);
+	const uint32_t ordinal_count = document_ids_.GetOrdinalCount();
+	return CountMatchedDocuments(*context, ordinal_count, ordinal_count);
+}
+
+size_t SearchServer::CountMatches(string_view raw_query) const {
+	return CountMatches(raw_query, DocumentFilter(DocumentStatus::ACTUAL));
+}
+
+bool SearchServer::AnyMatch(string_view raw_query, const DocumentFilter& filter) const {
+	const QueryContextLease context;
+	ParseQuery(raw_query, context->query, context->words);
+	CompileFilter(filter, context->allowed);
+	const Query& query = context->query;
+	const DocumentBitmap& allowed = context->allowed;
+
+	for (const uint32_t term_id : query.plus_terms) {
+		const bool found = inverted_index_.AnyPosting(term_id, [&](uint32_t ordinal) {
+			return allowed.Test(ordinal) && none_of(query.minus_terms.begin(), query.minus_terms.end(), [&](uint32_t minus_term_id) {
+				return forward_index_.HasTerm(ordinal, minus_term_id);
+				});
+			});
+		if (found) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SearchServer::AnyMatch(string_view raw_query) const {
+	return AnyMatch(raw_query, DocumentFilter(DocumentStatus::ACTUAL));
+}
+
+size_t SearchServer::EstimateMatches(string_view raw_query, const DocumentFilter& filter) const {
+	const uint32_t ordinal_count = document_ids_.GetOrdinalCount();
+	if (ordinal_count < MATCH_ESTIMATE_MIN_DOCUMENTS) {
+		return CountMatches(raw_query, filter);
+	}
+	const QueryContextLease context;
+	ParseQuery(raw_query, context->query, context->words);
+	CompileFilter(filter, context->allowed);
+
+	const uint32_t stride = MATCH_ESTIMATE_WINDOW * MATCH_ESTIMATE_SAMPLE_RATE;
+	const size_t sampled_count = CountMatchedDocuments(*context, MATCH_ESTIMATE_WINDOW, stride);
+	size_t sampled_ordinals = 0;
+	for (uint32_t first = 0; first < ordinal_count; first += stride) {
+		sampled_ordinals += min(MATCH_ESTIMATE_WINDOW, ordinal_count - first);
+	}
+	return static_cast<size_t>(llround(static_cast<double>(sampled_count) * ordinal_count / sampled_ordinals));
+}
+
+size_t SearchServer::EstimateMatches(string_view raw_query) const {
+	return EstimateMatches(raw_query, DocumentFilter(DocumentStatus::ACTUAL));
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries, const DocumentFilter& filter) const {
+	return FindTopDocumentsBatch(execution::seq, raw_queries, filter);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries) const {
+	return FindTopDocumentsBatch(execution::seq, raw_queries, DocumentFilter(DocumentStatus::ACTUAL));
+}
+
+SearchPage SearchServer::FindTopDocumentsAfter(string_view raw_query, const DocumentFilter& filter, const SearchCursor& cursor, size_t page_size) const {
+	if (page_size == 0) {
+		throw invalid_argument("Page size must be positive"s);
+	}
+	const QueryContextLease context;
+	ParseQuery(raw_query, context->query, context->words);
+	CompileFilter(filter, context->allowed);
+	ScoreAccumulator& accumulator = GetScoreAccumulator();
+	AccumulateScores(context->query, context->allowed, accumulator);
+
+	// Куча из page_size + 1 лучших документов после курсора, на вершине - худший из них.
+	// Лишний документ показывает, что есть следующая страница. Документы, которые заведомо
+	// стоят до курсора или после худшего в полной куче, отбрасываются по одной оценке
+	const Document& last_document = cursor.last_document_;
+	vector<Document> documents;
+	accumulator.ForEachMatched([&](uint32_t ordinal, double relevance) {
+		if (!cursor.IsStart() && relevance - last_document.relevance >= EPSILON) {
+			return;
+		}
+		if (documents.size() > page_size && documents.front().relevance - relevance >= EPSILON) {
+			return;
+		}
+		const Document document = { document_ids_.GetId(ordinal), relevance, ratings_[ordinal] };
+		if (!cursor.IsStart() && !IsRankedBefore(last_document, document)) {
+			return;
+		}
+		if (documents.size() <= page_size) {
+			documents.push_back(document);
+			push_heap(documents.begin(), documents.end(), IsRankedBefore);
+		}
+		else if (IsRankedBefore(document, documents.front())) {
+			pop_heap(documents.begin(), documents.end(), IsRankedBefore);
+			documents.back() = document;
+			push_heap(documents.begin(), documents.end(), IsRankedBefore);
+		}
+		});
+
+	const bool has_more = documents.size() > page_size;
+	sort_heap(documents.begin(), documents.end(), IsRankedBefore);
+	if (has_more) {
+		documents.pop_back();
+	}
+
+	SearchPage page;
+	if (has_more) {
+		page.next_cursor = SearchCursor(documents.back());
+	}
+	page.documents = move(documents);
+	return page;
+}
+
+SearchPage SearchServer::FindTopDocumentsAfter(string_view raw_query, const SearchCursor& cursor, size_t page_size) const {
+	return FindTopDocumentsAfter(raw_query, DocumentFilter(DocumentStatus::ACTUAL), cursor, page_size);
+}
+
 int SearchServer::GetDocumentCount() const {
-	return documents_.size();
+	return static_cast<int>(document_ids_.size());
 }
 
-set<int>::const_iterator SearchServer::begin() const {
+bool SearchServer::HasDocument(int document_id) const {
+	return document_ids_.Contains(document_id);
+}
+
+DocumentIdTable::Iterator SearchServer::begin() const {
 	return document_ids_.begin();
 }
 
-set<int>::const_iterator SearchServer::end() const {
+DocumentIdTable::Iterator SearchServer::end() const {
 	return document_ids_.end();
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-	static const map<string_view, double> word_freq_empty;
-	if (document_ids_.count(document_id)) {
-		return document_to_word_freqs_.at(document_id);
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+	const auto ordinal = document_ids_.FindOrdinal(document_id);
+	if (!ordinal) {
+		return {};
+	}
+	const auto [first, last] = forward_index_.GetEntries(*ordinal);
+	return { first, last, &dictionary_ };
+}
+
+DocumentStatus SearchServer::GetDocumentStatus(int document_id) const {
+	return statuses_[GetExistingOrdinal(document_id)];
+}
+
+int SearchServer::GetDocumentRating(int document_id) const {
+	return ratings_[GetExistingOrdinal(document_id)];
+}
+
+string_view SearchServer::GetDocumentText(int document_id) const {
+	const uint32_t ordinal = GetExistingOrdinal(document_id);
+	return texts_[ordinal].empty() ? mapped_texts_[ordinal] : string_view(texts_[ordinal]);
+}
+
+void SearchServer::RemoveDocument(int document_id) {
+	RemoveDocument(execution::seq, document_id);
+}
+
+namespace {
+
+// Переносит значения живых документов колонки на номера new_ordinals из DocumentIdTable::Renumber
+template <typename Column>
+void RenumberColumn(Column& column, const vector<uint32_t>& new_ordinals) {
+	for (size_t ordinal = 0; ordinal + 1 < new_ordinals.size(); ++ordinal) {
+		if (new_ordinals[ordinal] != new_ordinals[ordinal + 1]) {
+			column[new_ordinals[ordinal]] = move(column[ordinal]);
+		}
+	}
+	column.erase(column.begin() + new_ordinals.back(), column.end());
+}
+
+}  // namespace
+
+void SearchServer::RenumberDocuments() {
+	const vector<uint32_t> new_ordinals = document_ids_.Renumber();
+	forward_index_.Compact(new_ordinals);
+	inverted_index_.Compact(new_ordinals);
+	hot_terms_->Renumber(new_ordinals);
+	for (DocumentBitmap& bitmap : status_bitmaps_) {
+		bitmap.Renumber(new_ordinals);
+	}
+	RenumberColumn(ratings_, new_ordinals);
+	RenumberColumn(statuses_, new_ordinals);
+	RenumberColumn(texts_, new_ordinals);
+	RenumberColumn(mapped_texts_, new_ordinals);
+}
+
+MemoryStats SearchServer::GetMemoryStats() const {
+	MemoryStats stats;
+	stats.document_texts = memory_->document_texts.GetBytes();
+	stats.term_dictionary = memory_->term_dictionary.GetBytes();
+	stats.postings = memory_->postings.GetBytes();
+	stats.forward_index = memory_->forward_index.GetBytes();
+	stats.metadata = memory_->metadata.GetBytes();
+	stats.document_count = document_ids_.size();
+	stats.term_count = dictionary_.size();
+	stats.posting_count = inverted_index_.GetPostingCount();
+	stats.segment_count = inverted_index_.GetSegmentCount();
+	return stats;
+}
+
+void SearchServer::SetMemoryBudget(size_t bytes) {
+	memory_budget_ = bytes;
+}
+
+void SearchServer::Compact() {
+	dictionary_.Compact();
+	if (document_ids_.GetOrdinalCount() == document_ids_.size()) {
+		forward_index_.Compact();
+		inverted_index_.Compact();
 	}
 	else {
-		return word_freq_empty;
+		RenumberDocuments();
 	}
-	
+	ratings_.shrink_to_fit();
+	statuses_.shrink_to_fit();
+	texts_.shrink_to_fit();
+	mapped_texts_.shrink_to_fit();
+	UpdateHotTerms();
 }
 
-void SearchServer::RemoveDocument(int document_id) {
-	if (document_ids_.count(document_id) == 0) {
+void SearchServer::UpdateHotTerms() const {
+	if (!hot_terms_->IsUpdateDue()) {
 		return;
 	}
-	documents_.erase(document_id);
-	document_ids_.erase(document_id);
-
-	auto& words = document_to_word_freqs_.at(document_id);
-	for (auto const& [word, freq] : words) {
-		word_to_document_freqs_.at(word).erase(document_id);
+	for (const uint32_t term_id : hot_terms_->StartUpdate()) {
+		// Слово могло перестать быть частым в документах после удалений
+		if (inverted_index_.GetDocumentFreq(term_id) < HOT_TERM_MIN_DOCUMENTS) {
+			continue;
+		}
+		vector<Posting> postings;
+		postings.reserve(inverted_index_.GetDocumentFreq(term_id));
+		inverted_index_.ForEachPosting(term_id, [&postings](uint32_t ordinal, float term_freq) {
+			postings.push_back({ ordinal, term_freq });
+			});
+		hot_terms_->Install(term_id, move(postings));
 	}
+}
 
-	document_to_word_freqs_.erase(document_id);
+void SearchServer::RemoveDocument(const AdaptivePolicy&, int document_id) {
+	const auto ordinal = document_ids_.FindOrdinal(document_id);
+	if (!ordinal) {
+		return;
+	}
+	const auto [first, last] = forward_index_.GetEntries(*ordinal);
+	if (static_cast<size_t>(last - first) >= GetExecutionThresholds().remove_parallel_min_words) {
+		RemoveDocument(execution::par, document_id);
+	}
+	else {
+		RemoveDocument(execution::seq, document_id);
+	}
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
 	return MatchDocument(execution::seq, raw_query, document_id);
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&, string_view raw_query, int document_id) const
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy& policy, string_view raw_query, int document_id) const
 {
-	if (document_to_word_freqs_.count(document_id) == 0) {
+	const auto ordinal = document_ids_.FindOrdinal(document_id);
+	if (!ordinal) {
 		throw out_of_range("Out of range!");
 	}
-	const auto query = ParseQuery(raw_query, false);
-	const auto status = documents_.at(document_id).status;
+	return { MatchQueryWords(policy, ParseMatchQuery(raw_query), *ordinal), statuses_[*ordinal] };
+}
 
-	for (string_view word : query.minus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			continue;
-		}
-		if (word_to_document_freqs_.at(word).count(document_id)) {
-			return { {}, status };
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy& policy, string_view raw_query, int document_id) const
+{
+	const auto ordinal = document_ids_.FindOrdinal(document_id);
+	if (!ordinal) {
+		throw out_of_range("Out of range!");
+	}
+	return { MatchQueryWords(policy, ParseMatchQuery(raw_query), *ordinal), statuses_[*ordinal] };
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const AdaptivePolicy&, string_view raw_query, int document_id) const
+{
+	const auto ordinal = document_ids_.FindOrdinal(document_id);
+	if (!ordinal) {
+		throw out_of_range("Out of range!");
+	}
+	const auto query = ParseMatchQuery(raw_query);
+	const size_t word_count = query.plus_words.size() + query.minus_words.size();
+	if (word_count >= GetExecutionThresholds().match_parallel_min_words) {
+		return { MatchQueryWords(execution::par, query, *ordinal), statuses_[*ordinal] };
+	}
+	return { MatchQueryWords(execution::seq, query, *ordinal), statuses_[*ordinal] };
+}
+
+vector<string_view> SearchServer::MatchQueryWords(const execution::sequenced_policy&, const MatchQuery& query, uint32_t ordinal) const {
+	for (const QueryWord& word : query.minus_words) {
+		if (DocumentHasQueryWord(ordinal, word)) {
+			return {};
 		}
 	}
 
 	vector<string_view> matched_words;
-	for (string_view word : query.plus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			continue;
-		}
-		if (word_to_document_freqs_.at(word).count(document_id)) {
-			matched_words.push_back(word);
+	for (const QueryWord& word : query.plus_words) {
+		if (DocumentHasQueryWord(ordinal, word)) {
+			matched_words.push_back(word.is_prefix ? word.text : word.data);
 		}
 	}
-
-	return { matched_words, status };
+	sort(matched_words.begin(), matched_words.end());
+	matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end());
+	return matched_words;
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy&, string_view raw_query, int document_id) const
-{
-	if (document_to_word_freqs_.count(document_id) == 0) {
-		throw out_of_range("Out of range!");
-	}
-	const auto query = ParseQuery(raw_query, true);
-	const auto status = documents_.at(document_id).status;
-
+vector<string_view> SearchServer::MatchQueryWords(const execution::parallel_policy&, const MatchQuery& query, uint32_t ordinal) const {
 	const auto word_checker =
-		[&](auto& word) {
-		const auto it = word_to_document_freqs_.find(word);
-		return it != word_to_document_freqs_.end() && it->second.count(document_id);
+		[&](const QueryWord& word) {
+		return DocumentHasQueryWord(ordinal, word);
 	};
 
 	if (any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), word_checker)) {
-		return { {}, status };
+		return {};
 	}
 
+	// Ненайденные слова отмечаются пустой строкой: слова запроса не бывают пустыми
 	vector<string_view> matched_words(query.plus_words.size());
-	auto words_end = copy_if(execution::par,
+	transform(execution::par,
 		query.plus_words.begin(), query.plus_words.end(),
 		matched_words.begin(),
-		word_checker
+		[&](const QueryWord& word) {
+			return word_checker(word) ? (word.is_prefix ? word.text : word.data) : string_view{};
+		}
 	);
-	sort(matched_words.begin(), words_end);
-	words_end = unique(matched_words.begin(), words_end);
-	matched_words.erase(words_end, matched_words.end());
-	return { matched_words, status };
+	matched_words.erase(remove(matched_words.begin(), matched_words.end(), string_view{}), matched_words.end());
+	sort(matched_words.begin(), matched_words.end());
+	matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end());
+	return matched_words;
+}
+
+bool SearchServer::DocumentHasQueryWord(uint32_t ordinal, const QueryWord& word) const {
+	if (!word.is_prefix) {
+		const auto term_id = dictionary_.Find(word.data);
+		return term_id && forward_index_.HasTerm(ordinal, *term_id);
+	}
+	// Проверяются все слова с этим началом, без ограничения MAX_PREFIX_EXPANSION
+	vector<uint32_t> term_ids;
+	dictionary_.FindPrefix(word.data, term_ids);
+	return any_of(term_ids.begin(), term_ids.end(), [&](uint32_t term_id) {
+		return forward_index_.HasTerm(ordinal, term_id);
+		});
+}
+
+uint32_t SearchServer::GetExistingOrdinal(int document_id) const {
+	const auto ordinal = document_ids_.FindOrdinal(document_id);
+	if (!ordinal) {
+		throw out_of_range("Out of range!");
+	}
+	return *ordinal;
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
@@ -177,6 +468,22 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 	return rating_sum / static_cast<int>(ratings.size());
 }
 
+void SearchServer::CheckMemoryBudget(size_t text_size, size_t word_count) {
+	if (memory_budget_ == 0) {
+		return;
+	}
+	// Оценка сверху: каждое слово может дать запись в списке документов и в прямом индексе
+	const size_t estimate = text_size + sizeof(TrackedString) + sizeof(string_view) + sizeof(int) + sizeof(DocumentStatus)
+		+ word_count * (POSTING_SIZE_ESTIMATE + sizeof(TermFrequency));
+	if (GetMemoryStats().GetTotal() + estimate <= memory_budget_) {
+		return;
+	}
+	Compact();
+	if (GetMemoryStats().GetTotal() + estimate > memory_budget_) {
+		throw length_error("Memory budget exceeded"s);
+	}
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
 	if (text.empty()) {
 		throw invalid_argument("Query word is empty"s);
@@ -187,35 +494,526 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
 		is_minus = true;
 		word = word.substr(1);
 	}
+	const string_view word_text = word;
+	const bool is_escaped = word.size() >= 2 && word.substr(word.size() - 2) == "**"sv;
+	const bool is_prefix = !is_escaped && !word.empty() && word.back() == '*';
+	if (is_prefix || is_escaped) {
+		word.remove_suffix(1);
+	}
 	if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
 		throw invalid_argument("Query word "s + string(text) + " is invalid");
 	}
 
-	return { word, is_minus, IsStopWord(word) };
+	return { word, word_text, is_minus, !is_prefix && IsStopWord(word), is_prefix };
+}
+
+void SearchServer::ExpandPrefix(string_view prefix, size_t max_count, vector<uint32_t>& term_ids) const {
+	const size_t first = term_ids.size();
+	dictionary_.FindPrefix(prefix, term_ids);
+	// Слова, оставшиеся только в удалённых документах, не нужны
+	term_ids.erase(remove_if(term_ids.begin() + first, term_ids.end(), [this](uint32_t term_id) {
+		return inverted_index_.GetDocumentFreq(term_id) == 0;
+		}), term_ids.end());
+	if (term_ids.size() - first > max_count) {
+		nth_element(term_ids.begin() + first, term_ids.begin() + first + max_count, term_ids.end(), [this](uint32_t lhs, uint32_t rhs) {
+			const uint32_t lhs_freq = inverted_index_.GetDocumentFreq(lhs);
+			const uint32_t rhs_freq = inverted_index_.GetDocumentFreq(rhs);
+			return lhs_freq > rhs_freq || (lhs_freq == rhs_freq && lhs < rhs);
+			});
+		term_ids.resize(first + max_count);
+	}
 }
 
-SearchServer::Query SearchServer::ParseQuery(string_view text, bool skip_sort) const {
+SearchServer::Query SearchServer::ParseQuery(string_view text) const {
 	Query result;
+	vector<string_view> words;
+	ParseQuery(text, result, words);
+	return result;
+}
+
+void SearchServer::ParseQuery(string_view text, Query& result, vector<string_view>& words) const {
+	result.plus_terms.clear();
+	result.minus_terms.clear();
+	SplitIntoWords(text, words);
+	for (string_view word : words) {
+		const auto query_word = ParseQueryWord(word);
+		if (query_word.is_stop) {
+			continue;
+		}
+		auto& query_terms = query_word.is_minus ? result.minus_terms : result.plus_terms;
+		if (query_word.is_prefix) {
+			// Минус-слово раскрывается полностью, иначе часть исключаемых документов попала бы в результат
+			ExpandPrefix(query_word.data, query_word.is_minus ? numeric_limits<size_t>::max() : MAX_PREFIX_EXPANSION, query_terms);
+		}
+		else if (const auto term_id = FindQueryTerm(query_word.data)) {
+			query_terms.push_back(*term_id);
+		}
+	}
+	for (auto* terms : { &result.plus_terms, &result.minus_terms }) {
+		sort(terms->begin(), terms->end());
+		terms->erase(unique(terms->begin(), terms->end()), terms->end());
+	}
+}
+
+SearchServer::MatchQuery SearchServer::ParseMatchQuery(string_view text) const {
+	MatchQuery result;
 	for (string_view word : SplitIntoWords(text)) {
 		const auto query_word = ParseQueryWord(word);
 		if (!query_word.is_stop) {
-			if (query_word.is_minus) {
-				result.minus_words.push_back(query_word.data);
+			(query_word.is_minus ? result.minus_words : result.plus_words).push_back(query_word);
+		}
+	}
+	return result;
+}
+
+SearchServer::QueryContextPool& SearchServer::GetQueryContextPool() {
+	thread_local QueryContextPool pool;
+	return pool;
+}
+
+SearchServer::QueryContextLease::QueryContextLease() {
+	QueryContextPool& pool = GetQueryContextPool();
+	if (pool.depth == pool.contexts.size()) {
+		pool.contexts.push_back(make_unique<QueryContext>());
+	}
+	context_ = pool.contexts[pool.depth++].get();
+}
+
+SearchServer::QueryContextLease::~QueryContextLease() {
+	--GetQueryContextPool().depth;
+}
+
+optional<uint32_t> SearchServer::FindQueryTerm(string_view word) const {
+	const auto term_id = dictionary_.Find(word);
+	if (!term_id || inverted_index_.GetDocumentFreq(*term_id) == 0) {
+		return nullopt;
+	}
+	return term_id;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(uint32_t term_id) const {
+	return log(GetDocumentCount() * 1.0 / inverted_index_.GetDocumentFreq(term_id));
+}
+
+DocumentBitmap SearchServer::CompileFilter(const DocumentFilter& filter) const {
+	DocumentBitmap allowed;
+	CompileFilter(filter, allowed);
+	return allowed;
+}
+
+void SearchServer::CompileFilter(const DocumentFilter& filter, DocumentBitmap& allowed) const {
+	allowed.Clear(document_ids_.GetOrdinalCount());
+	if (filter.HasIds()) {
+		for (const int document_id : filter.GetIds()) {
+			const auto ordinal = document_ids_.FindOrdinal(document_id);
+			if (ordinal && filter(document_id, statuses_[*ordinal], ratings_[*ordinal])) {
+				allowed.Set(*ordinal);
 			}
-			else {
-				result.plus_words.push_back(query_word.data);
+		}
+		return;
+	}
+
+	for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+		if (filter.AcceptsStatus(static_cast<DocumentStatus>(status))) {
+			allowed |= status_bitmaps_[status];
+		}
+	}
+	if (filter.HasRatingRange()) {
+		// ForEach читает блок до вызова функции, поэтому сбрасывать биты при обходе безопасно
+		allowed.ForEach([&](uint32_t ordinal) {
+			if (!filter.AcceptsRating(ratings_[ordinal])) {
+				allowed.Reset(ordinal);
 			}
+			});
+	}
+}
+
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+	if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
+		if (lhs.rating == rhs.rating) {
+			return lhs.id < rhs.id;
 		}
+		return lhs.rating > rhs.rating;
+	}
+	else {
+		return lhs.relevance > rhs.relevance;
 	}
-	if (!skip_sort) {
-		for (auto* words : { &result.plus_words, &result.minus_words }) {
-			sort(words->begin(), words->end());
-			words->erase(unique(words->begin(), words->end()), words->end());
+}
+
+vector<Document> SearchServer::SelectTopDocuments(vector<Document> matched_documents) {
+	SortTopDocuments(matched_documents);
+	return matched_documents;
+}
+
+void SearchServer::SortTopDocuments(vector<Document>& documents) {
+	sort(documents.begin(), documents.end(), IsRankedBefore);
+	if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+		documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+	}
+}
+
+vector<Document> SearchServer::FindAllDocuments(const execution::sequenced_policy&, const Query& query, const DocumentBitmap& allowed) const {
+	ScoreAccumulator& accumulator = GetScoreAccumulator();
+	AccumulateScores(query, allowed, accumulator);
+	return MakeDocuments(accumulator.ExtractAll());
+}
+
+void SearchServer::AccumulateScores(const Query& query, const DocumentBitmap& allowed, ScoreAccumulator& accumulator) const {
+	const size_t allowed_count = allowed.Count();
+	// Для избирательного фильтра дешевле искать разрешённые документы
+	// в списке слова, чем проходить весь список
+	if (allowed_count == 0 || allowed_count * FILTER_PROBE_FACTOR >= CountQueryPostings(query)) {
+		AccumulateScores(query, [&allowed](uint32_t ordinal) {
+			return allowed.Test(ordinal);
+			}, accumulator);
+		return;
+	}
+
+	accumulator.Reset(document_ids_.GetOrdinalCount());
+	for (const uint32_t term_id : query.plus_terms) {
+		const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+		if (allowed_count * FILTER_PROBE_FACTOR < inverted_index_.CountPostings(term_id)) {
+			allowed.ForEach([&](uint32_t ordinal) {
+				const Posting* posting = inverted_index_.FindPosting(term_id, ordinal);
+				if (posting) {
+					accumulator.Add(ordinal, posting->term_freq * inverse_document_freq);
+				}
+				});
+		}
+		else {
+			inverted_index_.ForEachPosting(term_id, [&](uint32_t ordinal, float term_freq) {
+				if (allowed.Test(ordinal)) {
+					accumulator.Add(ordinal, term_freq * inverse_document_freq);
+				}
+				});
 		}
 	}
-	return result;
+
+	for (const uint32_t term_id : query.minus_terms) {
+		inverted_index_.ForEachPosting(term_id, [&accumulator](uint32_t ordinal, float) {
+			accumulator.Remove(ordinal);
+			});
+	}
+}
+
+ScoreAccumulator& SearchServer::GetScoreAccumulator() {
+	thread_local ScoreAccumulator accumulator;
+	return accumulator;
+}
+
+vector<Document> SearchServer::MakeDocuments(const vector<pair<uint32_t, double>>& scores) const {
+	vector<Document> documents;
+	MakeDocuments(scores, documents);
+	return documents;
+}
+
+void SearchServer::MakeDocuments(const vector<pair<uint32_t, double>>& scores, vector<Document>& documents) const {
+	documents.clear();
+	documents.reserve(scores.size());
+	for (const auto& [ordinal, relevance] : scores) {
+		documents.push_back({ document_ids_.GetId(ordinal), relevance, ratings_[ordinal] });
+	}
+}
+
+void SearchServer::FindTopMatchedDocuments(const execution::sequenced_policy&, const Query& query, const DocumentBitmap& allowed,
+	vector<Document>& result) const {
+	ScoreAccumulator& accumulator = GetScoreAccumulator();
+	AccumulateScores(query, allowed, accumulator);
+	MakeDocuments(accumulator.ExtractTopCandidates(MAX_RESULT_DOCUMENT_COUNT, EPSILON), result);
+	SortTopDocuments(result);
+}
+
+void SearchServer::FindTopMatchedDocuments(const AdaptivePolicy& policy, const Query& query, const DocumentBitmap& allowed,
+	vector<Document>& result) const {
+	if (ChooseSearchMode(CountQueryPostings(query)) == ExecutionMode::SEQUENTIAL) {
+		FindTopMatchedDocuments(execution::seq, query, allowed, result);
+		return;
+	}
+	result = SelectTopDocuments(FindAllDocuments(policy, query, allowed));
+}
+
+vector<Document> SearchServer::FindAllDocuments(const execution::parallel_policy& policy, const Query& query, const DocumentBitmap& allowed) const {
+	return FindAllDocuments(policy, query, [&allowed](uint32_t ordinal) {
+		return allowed.Test(ordinal);
+		});
+}
+
+vector<Document> SearchServer::FindAllDocuments(const ShardParallelPolicy& policy, const Query& query, const DocumentBitmap& allowed) const {
+	return FindAllDocuments(policy, query, [&allowed](uint32_t ordinal) {
+		return allowed.Test(ordinal);
+		});
+}
+
+vector<Document> SearchServer::FindAllDocuments(const AdaptivePolicy&, const Query& query, const DocumentBitmap& allowed) const {
+	switch (ChooseSearchMode(CountQueryPostings(query))) {
+	case ExecutionMode::SEQUENTIAL:
+		return FindAllDocuments(execution::seq, query, allowed);
+	case ExecutionMode::INTRA_QUERY_PARALLEL:
+		return FindAllDocuments(execution::par, query, allowed);
+	default:
+		return FindAllDocuments(SHARD_PARALLEL_POLICY, query, allowed);
+	}
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-	return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+bool SearchServer::FindHotTopDocuments(QueryContext& context, const DocumentFilter& filter, vector<Document>& result) const {
+	const Query& query = context.query;
+	if (!query.minus_terms.empty() || query.plus_terms.empty() || query.plus_terms.size() > HOT_QUERY_MAX_WORDS || filter.HasIds()) {
+		return false;
+	}
+	array<uint32_t, HOT_QUERY_MAX_WORDS> term_ids = {};
+	array<double, HOT_QUERY_MAX_WORDS> inverse_document_freqs = {};
+	const size_t term_count = query.plus_terms.size();
+	for (size_t i = 0; i < term_count; ++i) {
+		term_ids[i] = query.plus_terms[i];
+		inverse_document_freqs[i] = ComputeWordInverseDocumentFreq(term_ids[i]);
+	}
+	for (size_t i = 0; i < term_count; ++i) {
+		if (inverted_index_.GetDocumentFreq(term_ids[i]) >= HOT_TERM_MIN_DOCUMENTS) {
+			hot_terms_->RecordQuery(term_ids[i]);
+		}
+	}
+
+	const auto lock = hot_terms_->LockShared();
+	array<const ImpactList*, HOT_QUERY_MAX_WORDS> lists = {};
+	for (size_t i = 0; i < term_count; ++i) {
+		lists[i] = hot_terms_->Find(term_ids[i]);
+		if (!lists[i]) {
+			return false;
+		}
+	}
+
+	// Пороговый алгоритм: списки обходятся по убыванию вклада, и обход заканчивается,
+	// когда даже непросмотренный документ с текущими частотами всех слов не проходит
+	// порог кандидатов. Отбор кандидатов и сложение вкладов повторяют ExtractTopCandidates
+	// и AccumulateScores, поэтому результат совпадает с обычным поиском
+	vector<pair<uint32_t, double>>& candidates = context.candidates;
+	vector<double>& best_scores = context.best_scores;
+	candidates.clear();
+	best_scores.clear();
+	double threshold = -numeric_limits<double>::infinity();
+	array<size_t, HOT_QUERY_MAX_WORDS> positions = {};
+
+	while (true) {
+		double bound = 0.0;
+		double next_contribution = -1.0;
+		size_t next_list = term_count;
+		for (size_t i = 0; i < term_count; ++i) {
+			const ImpactList& list = *lists[i];
+			float term_freq = list.cut.term_freq;
+			if (positions[i] < list.postings.size()) {
+				term_freq = list.postings[positions[i]].term_freq;
+			}
+			else if (list.complete) {
+				continue;
+			}
+			const double contribution = term_freq * inverse_document_freqs[i];
+			bound += contribution;
+			if (contribution > next_contribution) {
+				next_contribution = contribution;
+				next_list = i;
+			}
+		}
+		if (next_list == term_count || (best_scores.size() == MAX_RESULT_DOCUMENT_COUNT && bound < threshold)) {
+			break;
+		}
+		// Неполный список кончился раньше, чем нашлись все кандидаты
+		if (positions[next_list] == lists[next_list]->postings.size()) {
+			return false;
+		}
+
+		const Posting posting = lists[next_list]->postings[positions[next_list]++];
+		if (!IsAllowedByFilter(posting.ordinal, filter)) {
+			continue;
+		}
+		double score = 0.0;
+		bool is_seen = false;
+		for (size_t i = 0; i < term_count; ++i) {
+			float term_freq = posting.term_freq;
+			if (i != next_list) {
+				const TermFrequency* entry = forward_index_.FindEntry(posting.ordinal, term_ids[i]);
+				if (!entry) {
+					continue;
+				}
+				term_freq = entry->term_freq;
+				is_seen = is_seen || lists[i]->IsConsumed({ posting.ordinal, term_freq }, positions[i]);
+			}
+			score += term_freq * inverse_document_freqs[i];
+		}
+		if (is_seen || score < threshold) {
+			continue;
+		}
+		candidates.push_back({ posting.ordinal, score });
+		if (best_scores.size() < MAX_RESULT_DOCUMENT_COUNT) {
+			best_scores.push_back(score);
+			push_heap(best_scores.begin(), best_scores.end(), greater<double>());
+		}
+		else if (score > best_scores.front()) {
+			pop_heap(best_scores.begin(), best_scores.end(), greater<double>());
+			best_scores.back() = score;
+			push_heap(best_scores.begin(), best_scores.end(), greater<double>());
+		}
+		if (best_scores.size() == MAX_RESULT_DOCUMENT_COUNT) {
+			threshold = best_scores.front() - EPSILON;
+		}
+	}
+
+	candidates.erase(remove_if(candidates.begin(), candidates.end(), [threshold](const pair<uint32_t, double>& candidate) {
+		return candidate.second < threshold;
+		}), candidates.end());
+	sort(candidates.begin(), candidates.end());
+	MakeDocuments(candidates, result);
+	SortTopDocuments(result);
+	return true;
+}
+
+bool SearchServer::IsAllowedByFilter(uint32_t ordinal, const DocumentFilter& filter) const {
+	return filter.AcceptsStatus(statuses_[ordinal]) && (!filter.HasRatingRange() || filter.AcceptsRating(ratings_[ordinal]));
+}
+
+size_t SearchServer::CountMatchedDocuments(QueryContext& context, uint32_t window_size, uint32_t stride) const {
+	const Query& query = context.query;
+	const DocumentBitmap& allowed = context.allowed;
+	const uint32_t ordinal_count = document_ids_.GetOrdinalCount();
+	const auto for_each_window = [&](auto function) {
+		for (uint32_t first = 0; first < ordinal_count; first += stride) {
+			function(first, first + min(window_size, ordinal_count - first));
+		}
+	};
+
+	// Одно слово без минус-слов: каждый документ встречается в списке один раз,
+	// и битовая карта для объединения не нужна
+	if (query.plus_terms.size() == 1 && query.minus_terms.empty()) {
+		const uint32_t term_id = query.plus_terms.front();
+		size_t count = 0;
+		for_each_window([&](uint32_t first, uint32_t last) {
+			inverted_index_.ForEachPosting(term_id, [&](uint32_t ordinal, float) {
+				count += allowed.Test(ordinal);
+				}, first, last);
+			});
+		return count;
+	}
+
+	DocumentBitmap& matched = context.matched;
+	matched.Clear(ordinal_count);
+	for (const uint32_t term_id : query.plus_terms) {
+		for_each_window([&](uint32_t first, uint32_t last) {
+			inverted_index_.ForEachPosting(term_id, [&matched](uint32_t ordinal, float) {
+				matched.Set(ordinal);
+				}, first, last);
+			});
+	}
+	matched &= allowed;
+	for (const uint32_t term_id : query.minus_terms) {
+		for_each_window([&](uint32_t first, uint32_t last) {
+			inverted_index_.ForEachPosting(term_id, [&matched](uint32_t ordinal, float) {
+				matched.Reset(ordinal);
+				}, first, last);
+			});
+	}
+	return matched.Count();
+}
+
+namespace {
+
+// Вызывает f(term_id, query_indexes) для каждого слова из отсортированного списка пар (term id, номер запроса)
+template <typename Function>
+void ForEachBatchTerm(const vector<pair<uint32_t, uint32_t>>& terms, vector<uint32_t>& query_indexes, Function f) {
+	for (size_t begin = 0; begin < terms.size();) {
+		query_indexes.clear();
+		size_t end = begin;
+		for (; end < terms.size() && terms[end].first == terms[begin].first; ++end) {
+			query_indexes.push_back(terms[end].second);
+		}
+		f(terms[begin].first, query_indexes);
+		begin = end;
+	}
+}
+
+}  // namespace
+
+void SearchServer::FindTopDocumentsBatch(const vector<Query>& queries, const DocumentBitmap& allowed, size_t first, size_t last,
+	vector<vector<Document>>& results) const {
+	vector<ScoreAccumulator>& accumulators = GetBatchAccumulators();
+	if (accumulators.size() < last - first) {
+		accumulators.resize(last - first);
+	}
+	const uint32_t ordinal_count = document_ids_.GetOrdinalCount();
+	for (size_t i = 0; i < last - first; ++i) {
+		accumulators[i].Reset(ordinal_count);
+	}
+
+	vector<pair<uint32_t, uint32_t>> plus_terms;
+	vector<pair<uint32_t, uint32_t>> minus_terms;
+	for (size_t i = first; i < last; ++i) {
+		for (const uint32_t term_id : queries[i].plus_terms) {
+			plus_terms.emplace_back(term_id, static_cast<uint32_t>(i - first));
+		}
+		for (const uint32_t term_id : queries[i].minus_terms) {
+			minus_terms.emplace_back(term_id, static_cast<uint32_t>(i - first));
+		}
+	}
+	// Слова запроса отсортированы по term id, поэтому при обходе слов пакета в том же
+	// порядке каждый запрос получает вклады так же, как и при отдельном поиске,
+	// и суммы релевантности совпадают до бита
+	sort(plus_terms.begin(), plus_terms.end());
+	sort(minus_terms.begin(), minus_terms.end());
+
+	// Список документов слова обходится один раз: вклады разрешённых документов
+	// собираются в буфер, который затем прибавляется к накопителю каждого запроса.
+	// Так в каждый момент запись идёт в один накопитель, а не вразброс по всем
+	vector<uint32_t> query_indexes;
+	vector<pair<uint32_t, double>> contributions;
+	vector<uint32_t> excluded;
+	ForEachBatchTerm(plus_terms, query_indexes, [&](uint32_t term_id, const vector<uint32_t>& term_queries) {
+		const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+		contributions.clear();
+		inverted_index_.ForEachPosting(term_id, [&](uint32_t ordinal, float term_freq) {
+			if (allowed.Test(ordinal)) {
+				contributions.emplace_back(ordinal, term_freq * inverse_document_freq);
+			}
+			});
+		for (const uint32_t index : term_queries) {
+			ScoreAccumulator& accumulator = accumulators[index];
+			for (const auto& [ordinal, contribution] : contributions) {
+				accumulator.Add(ordinal, contribution);
+			}
+		}
+		});
+	ForEachBatchTerm(minus_terms, query_indexes, [&](uint32_t term_id, const vector<uint32_t>& term_queries) {
+		excluded.clear();
+		inverted_index_.ForEachPosting(term_id, [&](uint32_t ordinal, float) {
+			excluded.push_back(ordinal);
+			});
+		for (const uint32_t index : term_queries) {
+			ScoreAccumulator& accumulator = accumulators[index];
+			for (const uint32_t ordinal : excluded) {
+				accumulator.Remove(ordinal);
+			}
+		}
+		});
+
+	for (size_t i = first; i < last; ++i) {
+		MakeDocuments(accumulators[i - first].ExtractTopCandidates(MAX_RESULT_DOCUMENT_COUNT, EPSILON), results[i]);
+		SortTopDocuments(results[i]);
+	}
+}
+
+size_t SearchServer::GetQueryBatchSize() const {
+	const size_t score_size = max<size_t>(1, document_ids_.GetOrdinalCount()) * sizeof(double);
+	return clamp<size_t>(QUERY_BATCH_SCORE_MEMORY / score_size, 1, MAX_QUERY_BATCH_SIZE);
+}
+
+vector<ScoreAccumulator>& SearchServer::GetBatchAccumulators() {
+	thread_local vector<ScoreAccumulator> accumulators;
+	return accumulators;
+}
+
+size_t SearchServer::CountQueryPostings(const Query& query) const {
+	size_t posting_count = 0;
+	for (const auto* terms : { &query.plus_terms, &query.minus_terms }) {
+		for (const uint32_t term_id : *terms) {
+			posting_count += inverted_index_.CountPostings(term_id);
+		}
+	}
+	return posting_count;
 }
@@ -2,24 +2,69 @@
 #include "document.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "document_bitmap.h"
+#include "document_filter.h"
+#include "document_id_table.h"
+#include "execution_cost_model.h"
+#include "memory_stats.h"
+#include "score_accumulator.h"
+#include "search_cursor.h"
+#include "segmented_index.h"
+#include "forward_index.h"
+#include "hot_term_cache.h"
+#include "term_dictionary.h"
 
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
+#include <array>
 #include <map>
+#include <memory>
 #include <set>
 #include <unordered_set>
 #include <algorithm>
+#include <climits>
 #include <cmath>
 #include <execution>
 #include <numeric>
+#include <optional>
 #include <thread>
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
 const size_t CONCURRENT_THREADS = std::thread::hardware_concurrency();
+// Во сколько раз список слова должен быть длиннее множества документов,
+// прошедших фильтр, чтобы искать эти документы в списке вместо его обхода
+const size_t FILTER_PROBE_FACTOR = 16;
+// Запросы из стольких слов без минус-слов отвечаются по спискам популярных слов
+const size_t HOT_QUERY_MAX_WORDS = 2;
+// Оценка числа найденных документов считает их точно в окнах по MATCH_ESTIMATE_WINDOW
+// номеров, взятых через каждые MATCH_ESTIMATE_SAMPLE_RATE окон. Для индекса меньше
+// MATCH_ESTIMATE_MIN_DOCUMENTS номеров оценка совпадает с точным числом
+const uint32_t MATCH_ESTIMATE_WINDOW = 4096;
+const uint32_t MATCH_ESTIMATE_SAMPLE_RATE = 16;
+const uint32_t MATCH_ESTIMATE_MIN_DOCUMENTS = 1 << 16;
+// Память оценок на один поток пакетного поиска: размер группы запросов,
+// обходящих списки документов вместе, подбирается под неё
+const size_t QUERY_BATCH_SCORE_MEMORY = size_t{ 16 } << 20;
+const size_t MAX_QUERY_BATCH_SIZE = 256;
+// Примерный объём памяти на одну запись списка документов: запас вектора
+// изменяемого сегмента и копия в новом сегменте на время слияния
+const size_t POSTING_SIZE_ESTIMATE = 32;
+// Слово запроса вида prefix* заменяется словами индекса, начинающимися с prefix.
+// Если их больше, остаются слова из наибольшего числа документов. Минус-слово
+// -prefix* не ограничивается: иначе запрос вернул бы исключаемые документы.
+// Слово, которое само кончается на '*', ищется удвоением последней '*': cat** - слово cat*
+const size_t MAX_PREFIX_EXPANSION = 64;
+// Удалённые документы занимают внутренние номера, пока живые документы
+// не перенумерованы. RemoveDocument перенумеровывает их, когда удалённых
+// номеров больше, чем живых документов и чем RENUMBER_MIN_REMOVED_DOCUMENTS
+const size_t RENUMBER_MIN_REMOVED_DOCUMENTS = 4096;
+
+struct CorpusLoadStats;
+class MappedFile;
 
 class SearchServer {
     
@@ -34,73 +79,286 @@ public:
 
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
     template <typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
     template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter) const;
+    template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+
+    // Результат записывается в result. Если вызывающий переиспользует result,
+    // последовательный поиск не выделяет память после прогрева
+    void FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, std::vector<Document>& result) const;
+    template <typename ExecutionPolicy>
+    void FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter, std::vector<Document>& result) const;
     
+    // Число документов, которые нашёл бы FindTopDocuments до отбора лучших.
+    // Плюс- и минус-слова вычисляются как объединение и разность множеств
+    // документов, без вычисления релевантности
+    size_t CountMatches(std::string_view raw_query, const DocumentFilter& filter) const;
+    size_t CountMatches(std::string_view raw_query) const;
+    // Найдётся ли хоть один документ; поиск останавливается на первом
+    bool AnyMatch(std::string_view raw_query, const DocumentFilter& filter) const;
+    bool AnyMatch(std::string_view raw_query) const;
+    // Оценка CountMatches по выборке номеров документов для больших индексов
+    size_t EstimateMatches(std::string_view raw_query, const DocumentFilter& filter) const;
+    size_t EstimateMatches(std::string_view raw_query) const;
+
+    // Пакетный поиск: запросы делятся на группы, и список документов слова,
+    // общего для нескольких запросов группы, обходится один раз.
+    // Результаты совпадают с FindTopDocuments для каждого запроса
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries, const DocumentFilter& filter) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries, const DocumentFilter& filter) const;
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries) const;
+
+    // Страница выдачи, следующая за курсором. Ранжирование совпадает с FindTopDocuments,
+    // при равных релевантности и рейтинге документы упорядочены по id
+    SearchPage FindTopDocumentsAfter(std::string_view raw_query, const DocumentFilter& filter, const SearchCursor& cursor, size_t page_size = MAX_RESULT_DOCUMENT_COUNT) const;
+    SearchPage FindTopDocumentsAfter(std::string_view raw_query, const SearchCursor& cursor, size_t page_size = MAX_RESULT_DOCUMENT_COUNT) const;
+
     int GetDocumentCount() const;
+    bool HasDocument(int document_id) const;
 
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    DocumentIdTable::Iterator begin() const;
+    DocumentIdTable::Iterator end() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    WordFrequencies GetWordFrequencies(int document_id) const;
+    // Данные документа; std::out_of_range, если документа нет
+    DocumentStatus GetDocumentStatus(int document_id) const;
+    int GetDocumentRating(int document_id) const;
+    std::string_view GetDocumentText(int document_id) const;
 
     void RemoveDocument(int document_id);
 
+    MemoryStats GetMemoryStats() const;
+    // Ограничение памяти индекса в байтах, 0 - без ограничения.
+    // Если документ не помещается даже после Compact, AddDocument бросает std::length_error
+    void SetMemoryBudget(size_t bytes);
+    // Освобождает память, оставшуюся от удалённых документов, и их внутренние номера
+    void Compact();
+    // Строит упорядоченные списки слов, которые стали часто встречаться в запросах.
+    // Запросы только считают слова. AddDocument, RemoveDocument и Compact обновляют
+    // списки сами; сервер без изменений должен вызывать метод периодически.
+    // Ничего не делает, пока не учтено HOT_TERM_UPDATE_PERIOD новых запросов.
+    // Может выполняться одновременно с запросами
+    void UpdateHotTerms() const;
+
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
+    void RemoveDocument(const AdaptivePolicy&, int document_id);
 
+    // Слова запроса, найденные в документе, - string_view на raw_query.
+    // Слово prefix* возвращается как есть, со '*', если в документе есть слово с этим началом
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const AdaptivePolicy&, std::string_view raw_query, int document_id) const;
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string text;
+    struct MemoryCounters {
+        MemoryCounter document_texts;
+        MemoryCounter term_dictionary;
+        MemoryCounter postings;
+        MemoryCounter forward_index;
+        MemoryCounter metadata;
     };
+
     const std::set<std::string, std::less<>>stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
-    
+    // Счётчики лежат в куче, чтобы аллокаторы контейнеров не зависели от адреса сервера
+    std::unique_ptr<MemoryCounters> memory_ = std::make_unique<MemoryCounters>();
+    size_t memory_budget_ = 0;
+
+    TermDictionary dictionary_{ &memory_->term_dictionary };
+    // Списки документов хранятся по term id и внутренним номерам документов
+    SegmentedIndex inverted_index_{ &memory_->postings };
+    // Упорядоченные по частоте списки популярных слов запросов
+    std::unique_ptr<HotTermCache> hot_terms_ = std::make_unique<HotTermCache>(&memory_->postings);
+    ForwardIndex forward_index_{ &memory_->forward_index };
+    DocumentIdTable document_ids_{ &memory_->metadata };
+
+    // Метаданные документов в колонках, индекс - внутренний номер документа
+    std::vector<int, CountingAllocator<int>> ratings_{ CountingAllocator<int>(&memory_->metadata) };
+    std::vector<DocumentStatus, CountingAllocator<DocumentStatus>> statuses_{ CountingAllocator<DocumentStatus>(&memory_->metadata) };
+    // Тексты, скопированные AddDocument. У документов из LoadCorpus строка пустая,
+    // а текст остаётся в отображённом файле корпуса и доступен через mapped_texts_
+    std::vector<TrackedString, CountingAllocator<TrackedString>> texts_{ CountingAllocator<TrackedString>(&memory_->document_texts) };
+    std::vector<std::string_view, CountingAllocator<std::string_view>> mapped_texts_{ CountingAllocator<std::string_view>(&memory_->document_texts) };
+    // Файлы корпусов, на которые указывают mapped_texts_, открыты, пока жив сервер
+    std::vector<std::shared_ptr<const MappedFile>> corpus_files_;
+    // Живые документы каждого статуса
+    std::array<DocumentBitmap, DOCUMENT_STATUS_COUNT> status_bitmaps_{
+        DocumentBitmap(&memory_->metadata), DocumentBitmap(&memory_->metadata),
+        DocumentBitmap(&memory_->metadata), DocumentBitmap(&memory_->metadata) };
+
+
+    // Загрузчик корпуса разбивает тексты на слова в своих потоках
+    friend CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path, size_t worker_count);
+    // Добавление документа, уже разбитого на слова с помощью SplitIntoWordsNoStop.
+    // Слова не проверяются повторно. Если is_mapped_text, document указывает
+    // в файл из corpus_files_ и не копируется
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings,
+        const std::vector<std::string_view>& words, bool is_mapped_text);
+    // Не меняет состояние сервера, поэтому может вызываться из нескольких потоков
+    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
 
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
+    void CheckMemoryBudget(size_t text_size, size_t word_count);
+    // Номер документа; std::out_of_range, если документа нет
+    uint32_t GetExistingOrdinal(int document_id) const;
+    // Сдвигает живые документы на номера удалённых с сохранением порядка
+    void RenumberDocuments();
     
     struct QueryWord {
         std::string_view data;
+        // Слово в тексте запроса без '-'
+        std::string_view text;
         bool is_minus;
         bool is_stop;
+        // Слово задаёт начало слов: data не содержит завершающей '*'.
+        // У слова, заканчивающегося на "**", последняя '*' тоже отбрасывается, но оно ищется целиком
+        bool is_prefix;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
+    // Дописывает в term_ids id слов живых документов, начинающихся с prefix, не больше max_count
+    void ExpandPrefix(std::string_view prefix, size_t max_count, std::vector<uint32_t>& term_ids) const;
 
+    // Слова запроса, которые есть в живых документах, в виде term id по возрастанию.
+    // prefix* заменяется на term id слов с этим началом
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<uint32_t> plus_terms;
+        std::vector<uint32_t> minus_terms;
     };
 
-    Query ParseQuery(std::string_view text, bool skip_sort = false) const;
+    Query ParseQuery(std::string_view text) const;
+    // Разбор в готовые буферы: words - место для слов запроса до разбора
+    void ParseQuery(std::string_view text, Query& result, std::vector<std::string_view>& words) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Слова запроса MatchDocument без стоп-слов. prefix* не раскрывается
+    struct MatchQuery {
+        std::vector<QueryWord> plus_words;
+        std::vector<QueryWord> minus_words;
+    };
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    MatchQuery ParseMatchQuery(std::string_view text) const;
+    // Есть ли слово запроса в документе; для prefix* - есть ли слово с этим началом
+    bool DocumentHasQueryWord(uint32_t ordinal, const QueryWord& word) const;
+    // Слова query, найденные в документе; пусто, если в документе есть минус-слово
+    std::vector<std::string_view> MatchQueryWords(const std::execution::sequenced_policy&, const MatchQuery& query, uint32_t ordinal) const;
+    std::vector<std::string_view> MatchQueryWords(const std::execution::parallel_policy&, const MatchQuery& query, uint32_t ordinal) const;
+
+    // Буферы разбора запроса и фильтра, сохраняющие память между запросами потока
+    struct QueryContext {
+        std::vector<std::string_view> words;
+        Query query;
+        DocumentBitmap allowed;
+        // Документы запроса для CountMatches
+        DocumentBitmap matched;
+        // Буферы поиска по спискам популярных слов
+        std::vector<std::pair<uint32_t, double>> candidates;
+        std::vector<double> best_scores;
+    };
+    struct QueryContextPool {
+        std::vector<std::unique_ptr<QueryContext>> contexts;
+        size_t depth = 0;
+    };
+    static QueryContextPool& GetQueryContextPool();
+
+    // Берёт буферы из пула потока на время запроса. Вложенный поиск на том же
+    // потоке (калибровка порогов внутри адаптивного запроса) получает свои буферы
+    class QueryContextLease {
+    public:
+        QueryContextLease();
+        ~QueryContextLease();
+        QueryContextLease(const QueryContextLease&) = delete;
+        QueryContextLease& operator=(const QueryContextLease&) = delete;
+
+        QueryContext* operator->() const {
+            return context_;
+        }
+        QueryContext& operator*() const {
+            return *context_;
+        }
+
+    private:
+        QueryContext* context_;
+    };
+
+    // Term id слова запроса, если слово есть хотя бы в одном живом документе
+    std::optional<uint32_t> FindQueryTerm(std::string_view word) const;
+    double ComputeWordInverseDocumentFreq(uint32_t term_id) const;
+
+    DocumentBitmap CompileFilter(const DocumentFilter& filter) const;
+    void CompileFilter(const DocumentFilter& filter, DocumentBitmap& allowed) const;
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+    static std::vector<Document> SelectTopDocuments(std::vector<Document> matched_documents);
+    static void SortTopDocuments(std::vector<Document>& documents);
+
+    template <typename OrdinalPredicate>
+    std::vector<Document> FindAllDocuments(const Query& query, OrdinalPredicate ordinal_predicate) const;
+    template <typename OrdinalPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, OrdinalPredicate ordinal_predicate) const;
+    template <typename OrdinalPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, OrdinalPredicate ordinal_predicate) const;
+    template <typename OrdinalPredicate>
+    std::vector<Document> FindAllDocuments(const ShardParallelPolicy&, const Query& query, OrdinalPredicate ordinal_predicate) const;
+    template <typename OrdinalPredicate>
+    std::vector<Document> FindAllDocuments(const AdaptivePolicy&, const Query& query, OrdinalPredicate ordinal_predicate) const;
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, const DocumentBitmap& allowed) const;
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, const DocumentBitmap& allowed) const;
+    std::vector<Document> FindAllDocuments(const ShardParallelPolicy&, const Query& query, const DocumentBitmap& allowed) const;
+    std::vector<Document> FindAllDocuments(const AdaptivePolicy&, const Query& query, const DocumentBitmap& allowed) const;
+
+    // Накопление релевантности в плотный накопитель для документов с номерами из [first_ordinal, last_ordinal)
+    template <typename OrdinalPredicate>
+    void AccumulateScores(const Query& query, OrdinalPredicate ordinal_predicate, ScoreAccumulator& accumulator,
+        uint32_t first_ordinal = 0, uint32_t last_ordinal = UINT32_MAX) const;
+    void AccumulateScores(const Query& query, const DocumentBitmap& allowed, ScoreAccumulator& accumulator) const;
+    // Накопитель текущего потока, переиспользуется между запросами
+    static ScoreAccumulator& GetScoreAccumulator();
+    std::vector<Document> MakeDocuments(const std::vector<std::pair<uint32_t, double>>& scores) const;
+    void MakeDocuments(const std::vector<std::pair<uint32_t, double>>& scores, std::vector<Document>& documents) const;
+
+    // Лучшие MAX_RESULT_DOCUMENT_COUNT документов. Последовательное выполнение
+    // отбирает их пороговым просмотром плотного накопителя, без сортировки всех найденных
+    template <typename ExecutionPolicy, typename OrdinalPredicate>
+    void FindTopMatchedDocuments(const ExecutionPolicy& policy, const Query& query, const OrdinalPredicate& ordinal_predicate, std::vector<Document>& result) const;
+    template <typename OrdinalPredicate>
+    void FindTopMatchedDocuments(const std::execution::sequenced_policy&, const Query& query, const OrdinalPredicate& ordinal_predicate, std::vector<Document>& result) const;
+    template <typename OrdinalPredicate>
+    void FindTopMatchedDocuments(const AdaptivePolicy& policy, const Query& query, const OrdinalPredicate& ordinal_predicate, std::vector<Document>& result) const;
+    void FindTopMatchedDocuments(const std::execution::sequenced_policy&, const Query& query, const DocumentBitmap& allowed, std::vector<Document>& result) const;
+    void FindTopMatchedDocuments(const AdaptivePolicy& policy, const Query& query, const DocumentBitmap& allowed, std::vector<Document>& result) const;
+
+    // Лучшие документы запроса из одного-двух слов по упорядоченным спискам популярных слов
+    // (пороговый алгоритм). false, если запрос не подходит или списков не хватило
+    bool FindHotTopDocuments(QueryContext& context, const DocumentFilter& filter, std::vector<Document>& result) const;
+    bool IsAllowedByFilter(uint32_t ordinal, const DocumentFilter& filter) const;
+
+    // Число документов запроса, прошедших фильтр, среди номеров из окон
+    // [first, first + window_size), начинающихся через каждые stride номеров
+    size_t CountMatchedDocuments(QueryContext& context, uint32_t window_size, uint32_t stride) const;
+
+    // Пакетный поиск для запросов с номерами из [first, last)
+    void FindTopDocumentsBatch(const std::vector<Query>& queries, const DocumentBitmap& allowed, size_t first, size_t last,
+        std::vector<std::vector<Document>>& results) const;
+    size_t GetQueryBatchSize() const;
+    // Накопители пакетного поиска текущего потока
+    static std::vector<ScoreAccumulator>& GetBatchAccumulators();
+
+    // Суммарная длина списков документов всех слов запроса - оценка его стоимости
+    size_t CountQueryPostings(const Query& query) const;
 };
 
 template <typename StringContainer>
@@ -120,31 +378,41 @@ inline std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw
 template<typename DocumentPredicate, typename ExecutionPolicy>
 inline std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const
 {
-    const auto query = ParseQuery(raw_query);
+    const QueryContextLease context;
+    ParseQuery(raw_query, context->query, context->words);
+
+    std::vector<Document> result;
+    FindTopMatchedDocuments(policy, context->query, [&](uint32_t ordinal) {
+        return document_predicate(document_ids_.GetId(ordinal), statuses_[ordinal], ratings_[ordinal]);
+        }, result);
+    return result;
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template<typename ExecutionPolicy>
+inline std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter) const
+{
+    std::vector<Document> result;
+    FindTopDocuments(policy, raw_query, filter, result);
+    return result;
+}
 
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template<typename ExecutionPolicy>
+inline void SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentFilter& filter, std::vector<Document>& result) const
+{
+    const QueryContextLease context;
+    ParseQuery(raw_query, context->query, context->words);
+    if (FindHotTopDocuments(*context, filter, result)) {
+        return;
     }
+    CompileFilter(filter, context->allowed);
 
-    return matched_documents;
+    FindTopMatchedDocuments(policy, context->query, context->allowed, result);
 }
 
 template<typename ExecutionPolicy>
 inline std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const
 {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-        });
+    return FindTopDocuments(policy, raw_query, DocumentFilter(status));
 }
 
 template<typename ExecutionPolicy>
@@ -153,107 +421,193 @@ inline std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& po
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+template<typename ExecutionPolicy>
+inline std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries,
+    const DocumentFilter& filter) const
+{
+    // Запросы разбираются без политики: исключение из алгоритма с политикой выполнения
+    // вызвало бы std::terminate, а некорректный запрос должен бросать std::invalid_argument
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const std::string& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(raw_query));
+    }
+    const DocumentBitmap allowed = CompileFilter(filter);
+
+    const size_t batch_size = GetQueryBatchSize();
+    std::vector<size_t> batch_starts;
+    for (size_t first = 0; first < queries.size(); first += batch_size) {
+        batch_starts.push_back(first);
+    }
+    std::vector<std::vector<Document>> results(queries.size());
+    std::for_each(policy, batch_starts.begin(), batch_starts.end(), [&](size_t first) {
+        FindTopDocumentsBatch(queries, allowed, first, std::min(first + batch_size, queries.size()), results);
+        });
+    return results;
+}
+
+template<typename ExecutionPolicy>
+inline std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries) const
+{
+    return FindTopDocumentsBatch(policy, raw_queries, DocumentFilter(DocumentStatus::ACTUAL));
 }
 
-template<typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const
+template <typename OrdinalPredicate>
+inline std::vector<Document> SearchServer::FindAllDocuments(const Query& query, OrdinalPredicate ordinal_predicate) const {
+    return FindAllDocuments(std::execution::seq, query, ordinal_predicate);
+}
+
+template<typename OrdinalPredicate>
+inline std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, OrdinalPredicate ordinal_predicate) const
 {
-    std::map<int, double> document_to_relevance;
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    ScoreAccumulator& accumulator = GetScoreAccumulator();
+    AccumulateScores(query, ordinal_predicate, accumulator);
+    return MakeDocuments(accumulator.ExtractAll());
+}
+
+template<typename OrdinalPredicate>
+inline void SearchServer::AccumulateScores(const Query& query, OrdinalPredicate ordinal_predicate, ScoreAccumulator& accumulator,
+    uint32_t first_ordinal, uint32_t last_ordinal) const
+{
+    accumulator.Reset(document_ids_.GetOrdinalCount());
+    for (const uint32_t term_id : query.plus_terms) {
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+        inverted_index_.ForEachPosting(term_id, [&](uint32_t ordinal, float term_freq) {
+            if (ordinal_predicate(ordinal)) {
+                accumulator.Add(ordinal, term_freq * inverse_document_freq);
             }
-        }
+            }, first_ordinal, last_ordinal);
     }
 
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
+    for (const uint32_t term_id : query.minus_terms) {
+        inverted_index_.ForEachPosting(term_id, [&accumulator](uint32_t ordinal, float) {
+            accumulator.Remove(ordinal);
+            }, first_ordinal, last_ordinal);
     }
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template<typename ExecutionPolicy, typename OrdinalPredicate>
+inline void SearchServer::FindTopMatchedDocuments(const ExecutionPolicy& policy, const Query& query, const OrdinalPredicate& ordinal_predicate,
+    std::vector<Document>& result) const
+{
+    result = SelectTopDocuments(FindAllDocuments(policy, query, ordinal_predicate));
+}
+
+template<typename OrdinalPredicate>
+inline void SearchServer::FindTopMatchedDocuments(const std::execution::sequenced_policy&, const Query& query, const OrdinalPredicate& ordinal_predicate,
+    std::vector<Document>& result) const
+{
+    ScoreAccumulator& accumulator = GetScoreAccumulator();
+    AccumulateScores(query, ordinal_predicate, accumulator);
+    MakeDocuments(accumulator.ExtractTopCandidates(MAX_RESULT_DOCUMENT_COUNT, EPSILON), result);
+    SortTopDocuments(result);
+}
+
+template<typename OrdinalPredicate>
+inline void SearchServer::FindTopMatchedDocuments(const AdaptivePolicy& policy, const Query& query, const OrdinalPredicate& ordinal_predicate,
+    std::vector<Document>& result) const
+{
+    if (ChooseSearchMode(CountQueryPostings(query)) == ExecutionMode::SEQUENTIAL) {
+        FindTopMatchedDocuments(std::execution::seq, query, ordinal_predicate, result);
+        return;
     }
-    return matched_documents;
+    result = SelectTopDocuments(FindAllDocuments(policy, query, ordinal_predicate));
 }
 
-template<typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const
+template<typename OrdinalPredicate>
+inline std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, OrdinalPredicate ordinal_predicate) const
 {
-    ConcurrentMap<int, double> tmp(CONCURRENT_THREADS);
+    ConcurrentMap<uint32_t, double> tmp(CONCURRENT_THREADS);
 
     for_each(std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
-        [&](std::string_view word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        tmp[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
+        query.plus_terms.begin(), query.plus_terms.end(),
+        [&](uint32_t term_id) {
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+            inverted_index_.ForEachPosting(term_id, [&](uint32_t ordinal, float term_freq) {
+                if (ordinal_predicate(ordinal)) {
+                    tmp[ordinal].ref_to_value += term_freq * inverse_document_freq;
                 }
-            }
-        
+                });
         });
-    std::map<int, double> document_to_relevance = tmp.BuildOrdinaryMap();
+    std::map<uint32_t, double> document_to_relevance = tmp.BuildOrdinaryMap();
 
     for_each(std::execution::par,
-        query.minus_words.begin(), query.minus_words.end(),
-        [&](std::string_view word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.erase(document_id);
-                }
-            }
+        query.minus_terms.begin(), query.minus_terms.end(),
+        [&](uint32_t term_id) {
+            inverted_index_.ForEachPosting(term_id, [&document_to_relevance](uint32_t ordinal, float) {
+                document_to_relevance.erase(ordinal);
+                });
         });
 
     std::vector<Document> matched_documents;
     matched_documents.reserve(document_to_relevance.size());
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    for (const auto [ordinal, relevance] : document_to_relevance) {
+        matched_documents.push_back({ document_ids_.GetId(ordinal), relevance, ratings_[ordinal] });
     }
     
     return matched_documents;
 }
 
+template<typename OrdinalPredicate>
+inline std::vector<Document> SearchServer::FindAllDocuments(const ShardParallelPolicy&, const Query& query, OrdinalPredicate ordinal_predicate) const
+{
+    const uint32_t ordinal_count = document_ids_.GetOrdinalCount();
+    const size_t shard_count = std::max<size_t>(1, CONCURRENT_THREADS);
+    std::vector<std::vector<Document>> shard_documents(shard_count);
+    std::vector<size_t> shards(shard_count);
+    std::iota(shards.begin(), shards.end(), 0);
+
+    // Диапазоны номеров не пересекаются, поэтому потокам не нужны блокировки
+    for_each(std::execution::par,
+        shards.begin(), shards.end(),
+        [&](size_t shard) {
+            const uint32_t first_ordinal = static_cast<uint32_t>(uint64_t{ ordinal_count } * shard / shard_count);
+            const uint32_t last_ordinal = static_cast<uint32_t>(uint64_t{ ordinal_count } * (shard + 1) / shard_count);
+            ScoreAccumulator& accumulator = GetScoreAccumulator();
+            AccumulateScores(query, ordinal_predicate, accumulator, first_ordinal, last_ordinal);
+            shard_documents[shard] = MakeDocuments(accumulator.ExtractAll());
+        });
+
+    std::vector<Document> matched_documents;
+    for (auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    return matched_documents;
+}
+
+template<typename OrdinalPredicate>
+inline std::vector<Document> SearchServer::FindAllDocuments(const AdaptivePolicy&, const Query& query, OrdinalPredicate ordinal_predicate) const
+{
+    switch (ChooseSearchMode(CountQueryPostings(query))) {
+    case ExecutionMode::SEQUENTIAL:
+        return FindAllDocuments(std::execution::seq, query, ordinal_predicate);
+    case ExecutionMode::INTRA_QUERY_PARALLEL:
+        return FindAllDocuments(std::execution::par, query, ordinal_predicate);
+    default:
+        return FindAllDocuments(SHARD_PARALLEL_POLICY, query, ordinal_predicate);
+    }
+}
+
 template<typename ExecutionPolicy>
 inline void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id)
 {
-    if (document_ids_.count(document_id) == 0) {
+    const auto ordinal = document_ids_.FindOrdinal(document_id);
+    if (!ordinal) {
         return;
     }
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-
-    auto& words_freqs = document_to_word_freqs_.at(document_id);
-    std::vector<const std::string*> v_words_freqs(words_freqs.size());
-    transform(
-        words_freqs.begin(), words_freqs.end(),
-        v_words_freqs.begin(),
-        [&](auto& word_freq) {return &(word_freq.first);}
-    );
-
-    for_each(policy,
-        v_words_freqs.begin(), v_words_freqs.end(),
-        [&](auto& word) {
-            word_to_document_freqs_.at(*word).erase(document_id);
-        });
-
-    document_to_word_freqs_.erase(document_id);
+    document_ids_.Remove(document_id);
+    status_bitmaps_[static_cast<int>(statuses_[*ordinal])].Reset(*ordinal);
+
+    const auto [first, last] = forward_index_.GetEntries(*ordinal);
+    hot_terms_->RemoveDocument(*ordinal, first, last);
+    inverted_index_.RemoveDocument(policy, *ordinal, first, last);
+    forward_index_.RemoveDocument(*ordinal);
+    TrackedString(texts_[*ordinal].get_allocator()).swap(texts_[*ordinal]);
+    mapped_texts_[*ordinal] = {};
+    UpdateHotTerms();
+
+    const size_t removed_count = document_ids_.GetOrdinalCount() - document_ids_.size();
+    if (removed_count > std::max(document_ids_.size(), RENUMBER_MIN_REMOVED_DOCUMENTS)) {
+        RenumberDocuments();
+    }
 }
\ No newline at end of file
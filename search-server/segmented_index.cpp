@@ -0,0 +1,154 @@
+#include "segmented_index.h"
+
+#include <chrono>
+
+using namespace std;
+
+SegmentedIndex::SegmentedIndex(MemoryCounter* counter)
+	: counter_(counter)
+	, mutable_segment_(counter)
+	, document_freqs_(CountingAllocator<uint32_t>(counter))
+	, alive_(counter) {
+}
+
+void SegmentedIndex::AddDocument(uint32_t ordinal, const vector<TermFrequency>& entries) {
+	InstallMerge(false);
+	for (const TermFrequency& entry : entries) {
+		if (entry.term_id >= document_freqs_.size()) {
+			document_freqs_.resize(entry.term_id + 1);
+		}
+		++document_freqs_[entry.term_id];
+	}
+	alive_.Set(ordinal);
+	mutable_segment_.AddDocument(ordinal, entries);
+	posting_count_ += entries.size();
+
+	if (mutable_segment_.GetDocumentCount() >= MUTABLE_SEGMENT_DOCUMENT_COUNT) {
+		SealMutableSegment();
+		StartMergeIfNeeded();
+	}
+}
+
+uint32_t SegmentedIndex::GetDocumentFreq(uint32_t term_id) const {
+	return term_id < document_freqs_.size() ? document_freqs_[term_id] : 0;
+}
+
+size_t SegmentedIndex::CountPostings(uint32_t term_id) const {
+	size_t posting_count = mutable_segment_.GetPostings(term_id).size();
+	for (const auto& segment : segments_) {
+		posting_count += segment->GetPostings(term_id).size();
+	}
+	return posting_count;
+}
+
+const Posting* SegmentedIndex::FindPosting(uint32_t term_id, uint32_t ordinal) const {
+	if (!alive_.Test(ordinal)) {
+		return nullptr;
+	}
+	if (!mutable_segment_.empty() && ordinal >= mutable_segment_.GetFirstOrdinal()) {
+		return mutable_segment_.GetPostings(term_id).Find(ordinal);
+	}
+	const auto segment = upper_bound(segments_.begin(), segments_.end(), ordinal,
+		[](uint32_t value, const shared_ptr<const SealedSegment>& segment) {
+			return value < segment->GetLastOrdinal();
+		});
+	if (segment == segments_.end() || ordinal < (*segment)->GetFirstOrdinal()) {
+		return nullptr;
+	}
+	return (*segment)->GetPostings(term_id).Find(ordinal);
+}
+
+size_t SegmentedIndex::GetPostingCount() const {
+	return posting_count_;
+}
+
+size_t SegmentedIndex::GetSegmentCount() const {
+	return segments_.size() + (mutable_segment_.empty() ? 0 : 1);
+}
+
+void SegmentedIndex::Compact() {
+	Compact(nullptr);
+}
+
+void SegmentedIndex::Compact(const vector<uint32_t>& new_ordinals) {
+	Compact(&new_ordinals);
+	alive_.Renumber(new_ordinals);
+}
+
+void SegmentedIndex::Compact(const vector<uint32_t>* new_ordinals) {
+	InstallMerge(true);
+	SealMutableSegment();
+
+	size_t stored_posting_count = 0;
+	int level = 0;
+	for (const auto& segment : segments_) {
+		stored_posting_count += segment->GetPostingCount();
+		level = max(level, segment->GetLevel() + 1);
+	}
+	if (segments_.size() > 1 || stored_posting_count != posting_count_ || new_ordinals) {
+		auto merged = make_shared<const SealedSegment>(segments_, alive_, level, counter_, new_ordinals);
+		segments_.clear();
+		if (merged->GetPostingCount() > 0) {
+			segments_.push_back(move(merged));
+		}
+	}
+	segments_.shrink_to_fit();
+	document_freqs_.shrink_to_fit();
+}
+
+void SegmentedIndex::SealMutableSegment() {
+	if (mutable_segment_.empty()) {
+		return;
+	}
+	auto segment = make_shared<const SealedSegment>(mutable_segment_, alive_, counter_);
+	mutable_segment_.Clear();
+	if (segment->GetPostingCount() > 0) {
+		segments_.push_back(move(segment));
+	}
+}
+
+void SegmentedIndex::InstallMerge(bool wait) {
+	if (!merge_.valid()) {
+		return;
+	}
+	if (!wait && merge_.wait_for(chrono::seconds(0)) != future_status::ready) {
+		return;
+	}
+	auto merged = merge_.get();
+	const auto first = segments_.begin() + merge_first_;
+	const auto last = first + SEGMENT_MERGE_FACTOR;
+	if (merged->GetPostingCount() > 0) {
+		*first = move(merged);
+		segments_.erase(first + 1, last);
+	}
+	else {
+		segments_.erase(first, last);
+	}
+	// После ожидания Compact сливает все сегменты сам
+	if (!wait) {
+		StartMergeIfNeeded();
+	}
+}
+
+void SegmentedIndex::StartMergeIfNeeded() {
+	if (merge_.valid() || segments_.size() < SEGMENT_MERGE_FACTOR) {
+		return;
+	}
+	// Уровни не возрастают от начала к концу, поэтому сегменты одного уровня
+	// идут подряд. Ищем ближайшую к концу группу из SEGMENT_MERGE_FACTOR сегментов
+	for (size_t last = segments_.size(); last >= SEGMENT_MERGE_FACTOR; --last) {
+		const size_t first = last - SEGMENT_MERGE_FACTOR;
+		const int level = segments_[first]->GetLevel();
+		if (segments_[last - 1]->GetLevel() != level) {
+			continue;
+		}
+		vector<shared_ptr<const SealedSegment>> sources(segments_.begin() + first, segments_.begin() + last);
+		merge_first_ = first;
+		// Копия карты живых документов: удаления во время слияния
+		// отфильтруются при обходе и выбросятся при следующем слиянии
+		merge_ = async(launch::async, [sources = move(sources), alive = alive_, level, counter = counter_] {
+			return make_shared<const SealedSegment>(sources, alive, level + 1, counter);
+			});
+		return;
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "document_bitmap.h"
+#include "forward_index.h"
+#include "index_segment.h"
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <future>
+#include <memory>
+#include <vector>
+
+// Сколько документов принимает изменяемый сегмент до запечатывания
+const size_t MUTABLE_SEGMENT_DOCUMENT_COUNT = 1024;
+// Сколько соседних сегментов одного уровня сливаются в сегмент следующего уровня
+const size_t SEGMENT_MERGE_FACTOR = 4;
+
+// Обратный индекс из сегментов. Новые документы попадают в изменяемый сегмент,
+// заполненный сегмент запечатывается в неизменяемый, а соседние сегменты одного
+// уровня сливаются в фоне. Готовое слияние подменяет сегменты при следующей записи.
+// Удалённые документы отмечаются в битовой карте живых документов и пропускаются
+// при обходе, их записи выбрасываются при слиянии. Частоты слов для IDF общие
+// для всех сегментов и учитывают только живые документы.
+class SegmentedIndex {
+public:
+    explicit SegmentedIndex(MemoryCounter* counter = nullptr);
+
+    void AddDocument(uint32_t ordinal, const std::vector<TermFrequency>& entries);
+    // [first, last) - записи документа в прямом индексе
+    template <typename ExecutionPolicy>
+    void RemoveDocument(ExecutionPolicy&& policy, uint32_t ordinal, const TermFrequency* first, const TermFrequency* last);
+
+    // Число живых документов со словом
+    uint32_t GetDocumentFreq(uint32_t term_id) const;
+    // Число записей слова во всех сегментах, включая ещё не выброшенные записи удалённых документов
+    size_t CountPostings(uint32_t term_id) const;
+
+    // function(ordinal, term_freq) для живых документов со словом из диапазона
+    // [first_ordinal, last_ordinal), по возрастанию номеров
+    template <typename Function>
+    void ForEachPosting(uint32_t term_id, Function function, uint32_t first_ordinal = 0, uint32_t last_ordinal = UINT32_MAX) const;
+    // Есть ли живой документ со словом, для которого predicate(ordinal) истинен.
+    // Обход останавливается на первом таком документе
+    template <typename Predicate>
+    bool AnyPosting(uint32_t term_id, Predicate predicate) const;
+    // Запись слова в живом документе или nullptr
+    const Posting* FindPosting(uint32_t term_id, uint32_t ordinal) const;
+
+    // Число записей живых документов
+    size_t GetPostingCount() const;
+    // Число сегментов, включая непустой изменяемый
+    size_t GetSegmentCount() const;
+
+    // Дожидается фонового слияния и сливает все сегменты в один без удалённых документов
+    void Compact();
+    // Compact с переносом документов на номера new_ordinals из DocumentIdTable::Renumber
+    void Compact(const std::vector<uint32_t>& new_ordinals);
+
+private:
+    MemoryCounter* counter_;
+    MutableSegment mutable_segment_;
+    // Упорядочены по номерам документов
+    std::vector<std::shared_ptr<const SealedSegment>> segments_;
+    std::vector<uint32_t, CountingAllocator<uint32_t>> document_freqs_;
+    DocumentBitmap alive_;
+    size_t posting_count_ = 0;
+
+    // Слияние segments_[merge_first_, merge_first_ + SEGMENT_MERGE_FACTOR) в фоне.
+    // Пока оно идёт, сегменты только дописываются в конец, поэтому индексы не сдвигаются
+    std::future<std::shared_ptr<const SealedSegment>> merge_;
+    size_t merge_first_ = 0;
+
+    void SealMutableSegment();
+    // Подменяет слитые сегменты результатом, если слияние закончено или wait == true.
+    // Без ожидания сразу начинает следующее слияние, если оно нужно
+    void InstallMerge(bool wait);
+    void Compact(const std::vector<uint32_t>* new_ordinals);
+    void StartMergeIfNeeded();
+};
+
+template <typename ExecutionPolicy>
+void SegmentedIndex::RemoveDocument(ExecutionPolicy&& policy, uint32_t ordinal, const TermFrequency* first, const TermFrequency* last) {
+    InstallMerge(false);
+    alive_.Reset(ordinal);
+    // Слова документа различны, поэтому потоки меняют разные счётчики
+    std::for_each(policy,
+        first, last,
+        [this](const TermFrequency& entry) {
+            --document_freqs_[entry.term_id];
+        });
+    posting_count_ -= last - first;
+}
+
+template <typename Predicate>
+bool SegmentedIndex::AnyPosting(uint32_t term_id, Predicate predicate) const {
+    const auto visit = [&](PostingList postings) {
+        return std::any_of(postings.begin(), postings.end(), [&](const Posting& posting) {
+            return alive_.Test(posting.ordinal) && predicate(posting.ordinal);
+            });
+    };
+    return std::any_of(segments_.begin(), segments_.end(), [&](const auto& segment) {
+        return visit(segment->GetPostings(term_id));
+        }) || (!mutable_segment_.empty() && visit(mutable_segment_.GetPostings(term_id)));
+}
+
+template <typename Function>
+void SegmentedIndex::ForEachPosting(uint32_t term_id, Function function, uint32_t first_ordinal, uint32_t last_ordinal) const {
+    const auto visit = [&](PostingList postings) {
+        const Posting* posting = first_ordinal == 0 ? postings.begin() : postings.LowerBound(first_ordinal);
+        for (; posting != postings.end() && posting->ordinal < last_ordinal; ++posting) {
+            if (alive_.Test(posting->ordinal)) {
+                function(posting->ordinal, posting->term_freq);
+            }
+        }
+    };
+
+    for (const auto& segment : segments_) {
+        if (segment->GetFirstOrdinal() >= last_ordinal) {
+            return;
+        }
+        if (segment->GetLastOrdinal() > first_ordinal) {
+            visit(segment->GetPostings(term_id));
+        }
+    }
+    if (!mutable_segment_.empty() && mutable_segment_.GetFirstOrdinal() < last_ordinal) {
+        visit(mutable_segment_.GetPostings(term_id));
+    }
+}
@@ -2,7 +2,12 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view str) {
     std::vector<std::string_view> words;
-    str.substr();
+    SplitIntoWords(str, words);
+    return words;
+}
+
+void SplitIntoWords(std::string_view str, std::vector<std::string_view>& words) {
+    words.clear();
     const int64_t pos_end = str.npos;
     while (true) {
         int64_t space = str.find(' ');
@@ -14,5 +19,4 @@ std::vector<std::string_view> SplitIntoWords(std::string_view str) {
             str.remove_prefix(space + 1);
         }
     }
-    return words;
 }
\ No newline at end of file
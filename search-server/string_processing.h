@@ -5,6 +5,8 @@
 #include <set>
 
 std::vector<std::string_view> SplitIntoWords(std::string_view str);
+// Заполняет words, сохраняя уже выделенную память
+void SplitIntoWords(std::string_view str, std::vector<std::string_view>& words);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
@@ -0,0 +1,278 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+void PutVarint(vector<char, CountingAllocator<char>>& bytes, size_t value) {
+	while (value >= 0x80) {
+		bytes.push_back(static_cast<char>(value | 0x80));
+		value >>= 7;
+	}
+	bytes.push_back(static_cast<char>(value));
+}
+
+size_t GetVarint(const char*& data) {
+	size_t value = 0;
+	for (int shift = 0; ; shift += 7) {
+		const auto byte = static_cast<unsigned char>(*data++);
+		value |= static_cast<size_t>(byte & 0x7F) << shift;
+		if (byte < 0x80) {
+			return value;
+		}
+	}
+}
+
+// Читает запись блока: длину общего с предыдущим словом начала и остаток слова
+string_view ReadEntry(const char*& data, size_t& shared) {
+	shared = GetVarint(data);
+	const size_t suffix_size = GetVarint(data);
+	const string_view suffix(data, suffix_size);
+	data += suffix_size;
+	return suffix;
+}
+
+size_t GetCommonPrefixSize(string_view lhs, string_view rhs) {
+	const size_t size = min(lhs.size(), rhs.size());
+	return mismatch(lhs.begin(), lhs.begin() + size, rhs.begin()).first - lhs.begin();
+}
+
+// Дописывает слова в порядке возрастания в блоки с общими началами
+class BlockWriter {
+public:
+	BlockWriter(vector<char, CountingAllocator<char>>& blocks, vector<uint32_t, CountingAllocator<uint32_t>>& block_offsets)
+		: blocks_(blocks)
+		, block_offsets_(block_offsets) {
+	}
+
+	void Add(string_view word) {
+		size_t shared = 0;
+		if (count_++ % TERM_BLOCK_SIZE == 0) {
+			block_offsets_.push_back(static_cast<uint32_t>(blocks_.size()));
+		}
+		else {
+			shared = GetCommonPrefixSize(previous_, word);
+		}
+		PutVarint(blocks_, shared);
+		PutVarint(blocks_, word.size() - shared);
+		blocks_.insert(blocks_.end(), word.begin() + shared, word.end());
+		previous_.assign(word);
+	}
+
+private:
+	vector<char, CountingAllocator<char>>& blocks_;
+	vector<uint32_t, CountingAllocator<uint32_t>>& block_offsets_;
+	string previous_;
+	size_t count_ = 0;
+};
+
+}  // namespace
+
+TermDictionary::TermDictionary(MemoryCounter* counter)
+	: counter_(counter)
+	, blocks_(CountingAllocator<char>(counter))
+	, block_offsets_(CountingAllocator<uint32_t>(counter))
+	, sorted_term_ids_(CountingAllocator<uint32_t>(counter))
+	, term_ranks_(CountingAllocator<uint32_t>(counter))
+	, word_chunks_(CountingAllocator<Bytes>(counter))
+	, recent_term_words_(CountingAllocator<string_view>(counter))
+	, recent_words_(CountingAllocator<pair<const string_view, uint32_t>>(counter)) {
+}
+
+uint32_t TermDictionary::Add(string_view word) {
+	if (const auto term_id = Find(word)) {
+		return *term_id;
+	}
+	const uint32_t term_id = static_cast<uint32_t>(size());
+	const string_view stored = StoreWord(word);
+	recent_term_words_.push_back(stored);
+	recent_words_.emplace(stored, term_id);
+	if (recent_words_.size() >= max(TERM_MERGE_MIN_SIZE, sorted_term_ids_.size() / TERM_MERGE_RATIO)) {
+		Compact();
+	}
+	return term_id;
+}
+
+optional<uint32_t> TermDictionary::Find(string_view word) const {
+	size_t common = 0;
+	size_t size = 0;
+	const size_t rank = LowerBound(word, common, size);
+	if (rank < sorted_term_ids_.size() && common == word.size() && size == word.size()) {
+		return sorted_term_ids_[rank];
+	}
+	const auto it = recent_words_.find(word);
+	if (it == recent_words_.end()) {
+		return nullopt;
+	}
+	return it->second;
+}
+
+string TermDictionary::GetWord(uint32_t term_id) const {
+	if (term_id >= sorted_term_ids_.size()) {
+		return string(recent_term_words_.at(term_id - sorted_term_ids_.size()));
+	}
+	const uint32_t rank = term_ranks_[term_id];
+	const char* data = blocks_.data() + block_offsets_[rank / TERM_BLOCK_SIZE];
+	string word;
+	size_t shared = 0;
+	for (size_t i = 0; i <= rank % TERM_BLOCK_SIZE; ++i) {
+		const string_view suffix = ReadEntry(data, shared);
+		word.resize(shared);
+		word.append(suffix);
+	}
+	return word;
+}
+
+void TermDictionary::FindPrefix(string_view prefix, vector<uint32_t>& term_ids) const {
+	size_t common = 0;
+	size_t size = 0;
+	size_t rank = LowerBound(prefix, common, size);
+	if (rank < sorted_term_ids_.size() && common == prefix.size()) {
+		// Следующие слова начинаются с prefix, пока их общее с предыдущим словом начало не короче prefix
+		const char* data = blocks_.data() + block_offsets_[rank / TERM_BLOCK_SIZE];
+		size_t shared = 0;
+		for (size_t i = 0; i <= rank % TERM_BLOCK_SIZE; ++i) {
+			ReadEntry(data, shared);
+		}
+		term_ids.push_back(sorted_term_ids_[rank]);
+		for (++rank; rank < sorted_term_ids_.size(); ++rank) {
+			const string_view suffix = ReadEntry(data, shared);
+			const bool is_block_head = rank % TERM_BLOCK_SIZE == 0;
+			if (is_block_head ? suffix.substr(0, prefix.size()) != prefix : shared < prefix.size()) {
+				break;
+			}
+			term_ids.push_back(sorted_term_ids_[rank]);
+		}
+	}
+
+	for (auto it = recent_words_.lower_bound(prefix); it != recent_words_.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+		term_ids.push_back(it->second);
+	}
+}
+
+size_t TermDictionary::size() const {
+	return sorted_term_ids_.size() + recent_term_words_.size();
+}
+
+void TermDictionary::Compact() {
+	if (recent_words_.empty()) {
+		return;
+	}
+	// Блоки читаются подряд и сливаются с новыми словами без обращения к строкам по term id
+	Bytes blocks{ CountingAllocator<char>(counter_) };
+	decltype(block_offsets_) block_offsets{ CountingAllocator<uint32_t>(counter_) };
+	decltype(sorted_term_ids_) sorted_term_ids{ CountingAllocator<uint32_t>(counter_) };
+	sorted_term_ids.reserve(sorted_term_ids_.size() + recent_words_.size());
+	BlockWriter writer(blocks, block_offsets);
+
+	const char* data = blocks_.data();
+	string word;
+	size_t shared = 0;
+	auto recent = recent_words_.begin();
+	for (size_t rank = 0; rank < sorted_term_ids_.size(); ++rank) {
+		const string_view suffix = ReadEntry(data, shared);
+		word.resize(shared);
+		word.append(suffix);
+		for (; recent != recent_words_.end() && recent->first < word; ++recent) {
+			writer.Add(recent->first);
+			sorted_term_ids.push_back(recent->second);
+		}
+		writer.Add(word);
+		sorted_term_ids.push_back(sorted_term_ids_[rank]);
+	}
+	for (; recent != recent_words_.end(); ++recent) {
+		writer.Add(recent->first);
+		sorted_term_ids.push_back(recent->second);
+	}
+
+	blocks.shrink_to_fit();
+	block_offsets.shrink_to_fit();
+	blocks_ = move(blocks);
+	block_offsets_ = move(block_offsets);
+	sorted_term_ids_ = move(sorted_term_ids);
+	term_ranks_.resize(sorted_term_ids_.size());
+	for (size_t rank = 0; rank < sorted_term_ids_.size(); ++rank) {
+		term_ranks_[sorted_term_ids_[rank]] = static_cast<uint32_t>(rank);
+	}
+
+	// Строки новых слов теперь есть только в блоках
+	recent_words_.clear();
+	recent_term_words_.clear();
+	recent_term_words_.shrink_to_fit();
+	word_chunks_.clear();
+}
+
+string_view TermDictionary::StoreWord(string_view word) {
+	if (word_chunks_.empty() || word_chunks_.back().capacity() - word_chunks_.back().size() < word.size()) {
+		// Куски не перевыделяются, поэтому string_view на сохранённые слова действительны до Compact
+		Bytes& chunk = word_chunks_.emplace_back(CountingAllocator<char>(counter_));
+		chunk.reserve(max(TERM_ARENA_CHUNK_SIZE, word.size()));
+	}
+	Bytes& chunk = word_chunks_.back();
+	const size_t offset = chunk.size();
+	chunk.insert(chunk.end(), word.begin(), word.end());
+	return string_view(chunk.data() + offset, word.size());
+}
+
+string_view TermDictionary::GetBlockHead(size_t block) const {
+	const char* data = blocks_.data() + block_offsets_[block];
+	size_t shared = 0;
+	return ReadEntry(data, shared);
+}
+
+size_t TermDictionary::LowerBound(string_view word, size_t& common, size_t& size) const {
+	common = 0;
+	size = 0;
+	if (block_offsets_.empty()) {
+		return 0;
+	}
+	// Последний блок, первое слово которого не больше word; если такого нет - первый блок
+	size_t first = 0;
+	size_t last = block_offsets_.size();
+	while (last - first > 1) {
+		const size_t middle = (first + last) / 2;
+		if (GetBlockHead(middle) <= word) {
+			first = middle;
+		}
+		else {
+			last = middle;
+		}
+	}
+
+	// Слова блока сравниваются с word без восстановления: previous_common - длина
+	// общего начала word и предыдущего слова, которое меньше word
+	const char* data = blocks_.data() + block_offsets_[first];
+	const size_t block_end = min((first + 1) * TERM_BLOCK_SIZE, sorted_term_ids_.size());
+	size_t previous_common = 0;
+	for (size_t rank = first * TERM_BLOCK_SIZE; rank < block_end; ++rank) {
+		size_t shared = 0;
+		const string_view suffix = ReadEntry(data, shared);
+		if (shared > previous_common) {
+			// Слово совпадает с предыдущим дальше, чем предыдущее с word, значит меньше word
+			continue;
+		}
+		if (shared < previous_common) {
+			common = shared;
+			size = shared + suffix.size();
+			return rank;
+		}
+		const string_view rest = word.substr(previous_common);
+		const size_t match = GetCommonPrefixSize(suffix, rest);
+		if (match == rest.size()
+			|| (match < suffix.size() && static_cast<unsigned char>(suffix[match]) > static_cast<unsigned char>(rest[match]))) {
+			common = previous_common + match;
+			size = shared + suffix.size();
+			return rank;
+		}
+		previous_common += match;
+	}
+	if (block_end < sorted_term_ids_.size()) {
+		// Все слова блока меньше word, следующее слово - начало следующего блока
+		const string_view head = GetBlockHead(first + 1);
+		common = GetCommonPrefixSize(head, word);
+		size = head.size();
+	}
+	return block_end;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "memory_stats.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Сколько слов в блоке отсортированного словаря. Первое слово блока хранится
+// целиком, остальные - длиной общего с предыдущим словом начала и остатком
+const size_t TERM_BLOCK_SIZE = 16;
+// Новые слова копятся в небольшом дереве и вливаются в блоки, когда их
+// наберётся TERM_MERGE_MIN_SIZE и не меньше 1/TERM_MERGE_RATIO от числа слов в блоках
+const size_t TERM_MERGE_MIN_SIZE = 1024;
+const size_t TERM_MERGE_RATIO = 8;
+// Размер куска памяти, в который подряд складываются строки новых слов
+const size_t TERM_ARENA_CHUNK_SIZE = 16 * 1024;
+
+// Словарь терминов: каждому слову индекса сопоставляется плотный id.
+// Слова хранятся только отсортированными в блоках с общими началами,
+// поэтому слова с общим началом идут подряд, а GetWord восстанавливает
+// слово из блока. Строки хранятся отдельно лишь у новых слов до Compact.
+class TermDictionary {
+public:
+    explicit TermDictionary(MemoryCounter* counter = nullptr);
+
+    uint32_t Add(std::string_view word);
+    std::optional<uint32_t> Find(std::string_view word) const;
+    std::string GetWord(uint32_t term_id) const;
+    // Дописывает в term_ids id всех слов, начинающихся с prefix, в неопределённом порядке
+    void FindPrefix(std::string_view prefix, std::vector<uint32_t>& term_ids) const;
+    size_t size() const;
+
+    // Вливает новые слова в отсортированные блоки
+    void Compact();
+
+private:
+    using Bytes = std::vector<char, CountingAllocator<char>>;
+
+    MemoryCounter* counter_;
+
+    // Отсортированные слова: блоки, начало каждого блока, term id слов
+    // по порядку и место каждого term id в этом порядке
+    Bytes blocks_;
+    std::vector<uint32_t, CountingAllocator<uint32_t>> block_offsets_;
+    std::vector<uint32_t, CountingAllocator<uint32_t>> sorted_term_ids_;
+    std::vector<uint32_t, CountingAllocator<uint32_t>> term_ranks_;
+
+    // Слова, ещё не влитые в блоки. Их term id идут подряд после слов блоков
+    std::deque<Bytes, CountingAllocator<Bytes>> word_chunks_;
+    std::vector<std::string_view, CountingAllocator<std::string_view>> recent_term_words_;
+    std::map<std::string_view, uint32_t, std::less<>, CountingAllocator<std::pair<const std::string_view, uint32_t>>> recent_words_;
+
+    std::string_view StoreWord(std::string_view word);
+    std::string_view GetBlockHead(size_t block) const;
+    // Номер первого слова в блоках, не меньшего word. В common - длина
+    // общего начала этого слова и word, в size - длина этого слова
+    size_t LowerBound(std::string_view word, size_t& common, size_t& size) const;
+};
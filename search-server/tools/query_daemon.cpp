@@ -0,0 +1,357 @@
+// Поисковая служба: загружает корпус в один SearchServer и отвечает на запросы
+// FindTopDocuments и MatchDocument по протоколу query_protocol.h через Unix-сокет.
+// Запуск: query_daemon <путь к сокету> <файл корпуса> [стоп-слова через пробел]
+//
+// Ввод-вывод ведёт один поток на epoll. Запросы, пришедшие за один проход
+// по готовым соединениям, выполняются одной пачкой параллельно, как в ProcessQueries.
+// Пока пачка выполняется, следующие запросы копятся в сокетах и образуют новую пачку,
+// поэтому под нагрузкой пачки растут сами, а без нагрузки запрос не ждёт соседей.
+#include "../corpus_loader.h"
+#include "../query_protocol.h"
+#include "../search_server.h"
+
+#if !defined(__linux__)
+#error "query_daemon uses epoll and requires Linux"
+#endif
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <execution>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const int MAX_EPOLL_EVENTS = 256;
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+// Сколько байт читается из одного соединения за проход, чтобы одно соединение не забирало всю пачку
+const size_t READ_BUDGET = 4 * READ_CHUNK_SIZE;
+// Соединение, не забирающее ответы, перестаёт читаться, пока очередь ответов не сократится
+const size_t MAX_OUTPUT_BACKLOG = 16 << 20;
+
+volatile sig_atomic_t stop_requested = 0;
+
+void RequestStop(int) {
+	stop_requested = 1;
+}
+
+struct Connection {
+	int fd = -1;
+	uint32_t events = 0;
+	string input;
+	string output;
+	size_t output_offset = 0;
+	// Клиент закончил отправку: соединение закрывается, когда уйдут все ответы
+	bool input_closed = false;
+
+	bool HasOutput() const {
+		return output_offset < output.size();
+	}
+};
+
+struct PendingRequest {
+	shared_ptr<Connection> connection;
+	uint32_t request_id = 0;
+	QueryType type = QueryType::FIND_TOP_DOCUMENTS;
+	DocumentStatus status = DocumentStatus::ACTUAL;
+	int document_id = 0;
+	string query;
+	string response;
+};
+
+int Listen(const string& path) {
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		throw invalid_argument("Socket path is too long: "s + path);
+	}
+	memcpy(address.sun_path, path.data(), path.size());
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw runtime_error("Cannot create socket: "s + strerror(errno));
+	}
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+		const string error = strerror(errno);
+		close(fd);
+		throw runtime_error("Cannot listen on "s + path + ": "s + error);
+	}
+	return fd;
+}
+
+void UpdateEvents(int epoll_fd, Connection& connection, bool is_new = false) {
+	const size_t backlog = connection.output.size() - connection.output_offset;
+	const bool want_input = !connection.input_closed && backlog < MAX_OUTPUT_BACKLOG;
+	const uint32_t events = (want_input ? uint32_t{ EPOLLIN } : 0) | (backlog > 0 ? uint32_t{ EPOLLOUT } : 0);
+	if (!is_new && events == connection.events) {
+		return;
+	}
+	epoll_event event = {};
+	event.events = events;
+	event.data.fd = connection.fd;
+	epoll_ctl(epoll_fd, is_new ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, connection.fd, &event);
+	connection.events = events;
+}
+
+// Читает доступные данные. false, если соединение закрыто или сломано
+bool ReadInput(Connection& connection) {
+	size_t budget = READ_BUDGET;
+	while (budget > 0) {
+		const size_t old_size = connection.input.size();
+		connection.input.resize(old_size + READ_CHUNK_SIZE);
+		const ssize_t received = read(connection.fd, &connection.input[old_size], READ_CHUNK_SIZE);
+		connection.input.resize(old_size + max<ssize_t>(received, 0));
+		if (received > 0) {
+			budget -= min(budget, static_cast<size_t>(received));
+			continue;
+		}
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+	return true;
+}
+
+// Отправляет накопленные ответы, сколько примет сокет. false, если соединение сломано
+bool WriteOutput(Connection& connection) {
+	while (connection.output_offset < connection.output.size()) {
+		const ssize_t sent = send(connection.fd, connection.output.data() + connection.output_offset,
+			connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+		if (sent > 0) {
+			connection.output_offset += sent;
+		}
+		else if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		}
+		else {
+			return false;
+		}
+	}
+	if (connection.output_offset == connection.output.size()) {
+		connection.output.clear();
+		connection.output_offset = 0;
+	}
+	return true;
+}
+
+// Переносит в пачку все целиком пришедшие запросы соединения.
+// Бросает std::invalid_argument, если клиент нарушил протокол
+void TakeRequests(const shared_ptr<Connection>& connection, vector<PendingRequest>& batch) {
+	const string_view input = connection->input;
+	size_t offset = 0;
+	QueryRequest request;
+	for (size_t frame_size; (frame_size = GetFrameSize(input.substr(offset))) != 0; offset += frame_size) {
+		ParseRequest(input.substr(offset, frame_size), request);
+		PendingRequest& pending = batch.emplace_back();
+		pending.connection = connection;
+		pending.request_id = request.request_id;
+		pending.type = request.type;
+		pending.status = request.status;
+		pending.document_id = request.document_id;
+		pending.query = request.query;
+	}
+	connection->input.erase(0, offset);
+}
+
+void Execute(const SearchServer& search_server, PendingRequest& request) {
+	try {
+		if (request.type == QueryType::FIND_TOP_DOCUMENTS) {
+			vector<Document> documents;
+			search_server.FindTopDocuments(request.query, DocumentFilter(request.status), documents);
+			AppendFindResponse(request.response, request.request_id, documents);
+		}
+		else {
+			const auto [words, status] = search_server.MatchDocument(request.query, request.document_id);
+			AppendMatchResponse(request.response, request.request_id, words, status);
+		}
+	}
+	catch (const exception& e) {
+		// Ошибка в одном запросе не задевает остальные запросы пачки
+		request.response.clear();
+		AppendErrorResponse(request.response, request.request_id, request.type, e.what());
+	}
+}
+
+class QueryDaemon {
+public:
+	QueryDaemon(const SearchServer& search_server, const string& socket_path)
+		: search_server_(search_server)
+		, socket_path_(socket_path)
+		, listen_fd_(Listen(socket_path))
+		, epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {
+		if (epoll_fd_ < 0) {
+			close(listen_fd_);
+			throw runtime_error("Cannot create epoll: "s + strerror(errno));
+		}
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = listen_fd_;
+		epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+	}
+
+	~QueryDaemon() {
+		for (const auto& [fd, connection] : connections_) {
+			close(fd);
+		}
+		close(epoll_fd_);
+		close(listen_fd_);
+		unlink(socket_path_.c_str());
+	}
+
+	void Run() {
+		epoll_event events[MAX_EPOLL_EVENTS];
+		vector<PendingRequest> batch;
+		while (!stop_requested) {
+			const int event_count = epoll_wait(epoll_fd_, events, MAX_EPOLL_EVENTS, -1);
+			if (event_count < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw runtime_error("epoll_wait failed: "s + strerror(errno));
+			}
+
+			for (int i = 0; i < event_count; ++i) {
+				const int fd = events[i].data.fd;
+				if (fd == listen_fd_) {
+					AcceptConnections();
+					continue;
+				}
+				const auto connection = connections_.find(fd);
+				if (connection == connections_.end()) {
+					continue;
+				}
+				if (!HandleEvents(connection->second, events[i].events, batch)) {
+					CloseConnection(fd);
+				}
+			}
+
+			if (batch.empty()) {
+				continue;
+			}
+			for_each(execution::par, batch.begin(), batch.end(), [this](PendingRequest& request) {
+				Execute(search_server_, request);
+				});
+			// Ответы дописываются в порядке запросов, поэтому в каждом соединении порядок сохраняется
+			for (PendingRequest& request : batch) {
+				request.connection->output += request.response;
+			}
+			for (const PendingRequest& request : batch) {
+				Connection& connection = *request.connection;
+				if (connection.fd < 0 || !connection.HasOutput()) {
+					continue;
+				}
+				const int fd = connection.fd;
+				if (WriteOutput(connection) && (connection.HasOutput() || !connection.input_closed)) {
+					UpdateEvents(epoll_fd_, connection);
+				}
+				else {
+					CloseConnection(fd);
+				}
+			}
+			batch.clear();
+			// Сервер не меняется, поэтому списки частых слов строятся здесь, между пакетами
+			search_server_.UpdateHotTerms();
+		}
+	}
+
+private:
+	const SearchServer& search_server_;
+	string socket_path_;
+	int listen_fd_;
+	int epoll_fd_;
+	unordered_map<int, shared_ptr<Connection>> connections_;
+
+	void AcceptConnections() {
+		while (true) {
+			const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return;
+			}
+			auto connection = make_shared<Connection>();
+			connection->fd = fd;
+			UpdateEvents(epoll_fd_, *connection, true);
+			connections_.emplace(fd, move(connection));
+		}
+	}
+
+	bool HandleEvents(const shared_ptr<Connection>& connection, uint32_t events, vector<PendingRequest>& batch) {
+		if ((events & EPOLLOUT) && !WriteOutput(*connection)) {
+			return false;
+		}
+		const size_t batch_size = batch.size();
+		if (!connection->input_closed && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+			connection->input_closed = !ReadInput(*connection);
+			try {
+				TakeRequests(connection, batch);
+			}
+			catch (const invalid_argument& e) {
+				cerr << "Closing connection: "s << e.what() << endl;
+				return false;
+			}
+		}
+		// Клиент, закончивший отправку, всё равно получает ответы на уже присланные запросы
+		if (connection->input_closed && !connection->HasOutput() && batch.size() == batch_size) {
+			return false;
+		}
+		UpdateEvents(epoll_fd_, *connection);
+		return true;
+	}
+
+	void CloseConnection(int fd) {
+		const auto connection = connections_.find(fd);
+		if (connection == connections_.end()) {
+			return;
+		}
+		epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+		close(fd);
+		connection->second->fd = -1;
+		connections_.erase(connection);
+	}
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		cerr << "Usage: "s << argv[0] << " <socket path> <corpus file> [stop words]"s << endl;
+		return 1;
+	}
+	signal(SIGINT, RequestStop);
+	signal(SIGTERM, RequestStop);
+	signal(SIGPIPE, SIG_IGN);
+
+	try {
+		SearchServer search_server(string(argc > 3 ? argv[3] : ""));
+		cerr << LoadCorpus(search_server, argv[2]) << endl;
+
+		QueryDaemon daemon(search_server, argv[1]);
+		cerr << "Listening on "s << argv[1] << endl;
+		daemon.Run();
+	}
+	catch (const exception& e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+}
@@ -0,0 +1,195 @@
+// Нагрузочный клиент поисковой службы: несколько соединений, в каждом до depth
+// запросов FindTopDocuments в полёте. Печатает пропускную способность и задержки.
+// Запуск: query_load <путь к сокету> <файл запросов> [соединения] [глубина конвейера] [секунды]
+#include "../query_protocol.h"
+
+#if !defined(__linux__)
+#error "query_load requires Linux"
+#endif
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace chrono;
+
+namespace {
+
+struct ClientStats {
+	vector<uint32_t> latencies_us;
+	size_t error_count = 0;
+};
+
+int Connect(const string& path) {
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		throw invalid_argument("Socket path is too long: "s + path);
+	}
+	memcpy(address.sun_path, path.data(), path.size());
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		const string error = strerror(errno);
+		if (fd >= 0) {
+			close(fd);
+		}
+		throw runtime_error("Cannot connect to "s + path + ": "s + error);
+	}
+	return fd;
+}
+
+void SendAll(int fd, string& output) {
+	for (size_t offset = 0; offset < output.size();) {
+		const ssize_t sent = send(fd, output.data() + offset, output.size() - offset, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			throw runtime_error("Send failed: "s + strerror(errno));
+		}
+		offset += sent;
+	}
+	output.clear();
+}
+
+// Держит в соединении depth запросов до наступления deadline, затем дожидается оставшихся ответов
+ClientStats RunClient(const string& socket_path, const vector<string>& queries, size_t first_query,
+	size_t depth, steady_clock::time_point deadline) {
+	const int fd = Connect(socket_path);
+	ClientStats stats;
+	deque<steady_clock::time_point> sent_at;
+	string output;
+	string input;
+	size_t next_query = first_query;
+	uint32_t next_request_id = 0;
+
+	const auto send_request = [&] {
+		AppendFindRequest(output, next_request_id++, queries[next_query], DocumentStatus::ACTUAL);
+		next_query = (next_query + 1) % queries.size();
+		sent_at.push_back(steady_clock::now());
+	};
+
+	try {
+		for (size_t i = 0; i < depth; ++i) {
+			send_request();
+		}
+		SendAll(fd, output);
+
+		QueryResponse response;
+		char buffer[64 * 1024];
+		while (!sent_at.empty()) {
+			const ssize_t received = read(fd, buffer, sizeof(buffer));
+			if (received < 0 && errno == EINTR) {
+				continue;
+			}
+			if (received <= 0) {
+				throw runtime_error("Connection closed by server"s);
+			}
+			input.append(buffer, received);
+
+			size_t offset = 0;
+			for (size_t frame_size; (frame_size = GetFrameSize(string_view(input).substr(offset))) != 0; offset += frame_size) {
+				ParseResponse(string_view(input).substr(offset, frame_size), response);
+				const auto now = steady_clock::now();
+				stats.latencies_us.push_back(static_cast<uint32_t>(duration_cast<microseconds>(now - sent_at.front()).count()));
+				stats.error_count += response.is_ok ? 0 : 1;
+				sent_at.pop_front();
+				if (now < deadline) {
+					send_request();
+				}
+			}
+			input.erase(0, offset);
+			SendAll(fd, output);
+		}
+	}
+	catch (...) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+	return stats;
+}
+
+uint32_t GetPercentile(const vector<uint32_t>& sorted, double percentile) {
+	return sorted[min(sorted.size() - 1, static_cast<size_t>(percentile * sorted.size()))];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		cerr << "Usage: "s << argv[0] << " <socket path> <queries file> [connections=4] [pipeline depth=32] [seconds=10]"s << endl;
+		return 1;
+	}
+	const string socket_path = argv[1];
+	const size_t connection_count = argc > 3 ? stoul(argv[3]) : 4;
+	const size_t depth = argc > 4 ? stoul(argv[4]) : 32;
+	const int seconds = argc > 5 ? stoi(argv[5]) : 10;
+
+	vector<string> queries;
+	ifstream queries_file(argv[2]);
+	for (string line; getline(queries_file, line);) {
+		if (!line.empty()) {
+			queries.push_back(move(line));
+		}
+	}
+	if (queries.empty() || connection_count == 0 || depth == 0) {
+		cerr << "Nothing to send"s << endl;
+		return 1;
+	}
+
+	vector<ClientStats> stats(connection_count);
+	vector<string> errors(connection_count);
+	vector<thread> clients;
+	const auto start = steady_clock::now();
+	const auto deadline = start + std::chrono::seconds(seconds);
+	for (size_t i = 0; i < connection_count; ++i) {
+		// Соединения начинают с разных запросов, чтобы не идти по файлу в ногу
+		clients.emplace_back([&, i] {
+			try {
+				stats[i] = RunClient(socket_path, queries, i * queries.size() / connection_count, depth, deadline);
+			}
+			catch (const exception& e) {
+				errors[i] = e.what();
+			}
+			});
+	}
+	for (thread& client : clients) {
+		client.join();
+	}
+	const double elapsed = duration<double>(steady_clock::now() - start).count();
+
+	vector<uint32_t> latencies;
+	size_t error_count = 0;
+	for (size_t i = 0; i < connection_count; ++i) {
+		if (!errors[i].empty()) {
+			cerr << "Connection "s << i << ": "s << errors[i] << endl;
+		}
+		latencies.insert(latencies.end(), stats[i].latencies_us.begin(), stats[i].latencies_us.end());
+		error_count += stats[i].error_count;
+	}
+	if (latencies.empty()) {
+		cerr << "No responses received"s << endl;
+		return 1;
+	}
+	sort(latencies.begin(), latencies.end());
+
+	cout << "requests: "s << latencies.size() << ", errors: "s << error_count << endl;
+	cout << "throughput: "s << static_cast<size_t>(latencies.size() / elapsed) << " req/s"s << endl;
+	cout << "latency us: p50 "s << GetPercentile(latencies, 0.5) << ", p99 "s << GetPercentile(latencies, 0.99)
+		<< ", max "s << latencies.back() << endl;
+}
@@ -0,0 +1,357 @@
+// Проигрывание журнала запросов и изменений на загруженном индексе из нескольких потоков-клиентов.
+// Запуск: query_replay <файл корпуса> <журнал> [--clients N] [--rate операций в секунду]
+//     [--interval секунды] [--stop-words "слова"] [--slo-p99 мкс] [--slo-p999 мкс]
+//
+// Журнал: по операции на строку, поля разделены табуляцией:
+//   F <запрос>           FindTopDocuments через RequestQueue
+//   M <запрос>           AddMatchRequest: найдётся ли хоть один документ
+//   A <строка корпуса>   AddDocument: id, статус, рейтинги и текст в формате LoadCorpus
+//   R <id>               RemoveDocument
+// Операции раздаются клиентам в порядке журнала. Без --rate каждый клиент берёт
+// следующую операцию, как только закончил предыдущую (замкнутый цикл). С --rate
+// операции приходят с постоянной частотой (открытый цикл), и задержка считается
+// от назначенного времени прихода, поэтому в неё входит ожидание свободного клиента.
+// Поиск идёт под разделяемой блокировкой, изменения - под исключительной:
+// SearchServer не допускает поиск одновременно с изменением.
+// По каждому интервалу и по всему прогону печатаются пропускная способность,
+// задержки поиска p50/p99/p999, доля запросов без результатов и задержка изменений.
+// Если задано ограничение на p99 или p999 поиска и прогон его нарушил, код возврата - 2.
+#include "../corpus_loader.h"
+#include "../request_queue.h"
+#include "../search_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace chrono;
+
+namespace {
+
+enum class OperationType {
+	FIND,
+	MATCH,
+	ADD,
+	REMOVE,
+};
+
+struct Operation {
+	OperationType type = OperationType::FIND;
+	// Запрос для FIND и MATCH
+	string query;
+	// Документ для ADD, текст указывает в содержимое журнала
+	CorpusDocument document;
+	// Документ для REMOVE
+	int document_id = 0;
+};
+
+struct ReplayOptions {
+	string corpus_path;
+	string log_path;
+	string stop_words;
+	size_t client_count = 4;
+	double rate = 0.0;
+	double interval = 1.0;
+	optional<uint32_t> slo_p99_us;
+	optional<uint32_t> slo_p999_us;
+};
+
+// Результаты операций, завершившихся в одном интервале
+struct IntervalStats {
+	vector<uint32_t> query_latencies_us;
+	vector<uint32_t> update_latencies_us;
+	size_t zero_result_count = 0;
+	size_t error_count = 0;
+
+	void Merge(const IntervalStats& other) {
+		query_latencies_us.insert(query_latencies_us.end(), other.query_latencies_us.begin(), other.query_latencies_us.end());
+		update_latencies_us.insert(update_latencies_us.end(), other.update_latencies_us.begin(), other.update_latencies_us.end());
+		zero_result_count += other.zero_result_count;
+		error_count += other.error_count;
+	}
+};
+
+ReplayOptions ParseOptions(int argc, char* argv[]) {
+	if (argc < 3) {
+		throw invalid_argument("Usage: "s + argv[0] + " <corpus file> <log file> [--clients N] [--rate ops/s] [--interval seconds]"s
+			+ " [--stop-words words] [--slo-p99 us] [--slo-p999 us]"s);
+	}
+	ReplayOptions options;
+	options.corpus_path = argv[1];
+	options.log_path = argv[2];
+	for (int i = 3; i < argc; i += 2) {
+		const string_view name = argv[i];
+		if (i + 1 == argc) {
+			throw invalid_argument("No value for option "s + string(name));
+		}
+		const string value = argv[i + 1];
+		if (name == "--clients"sv) {
+			options.client_count = stoul(value);
+		}
+		else if (name == "--rate"sv) {
+			options.rate = stod(value);
+		}
+		else if (name == "--interval"sv) {
+			options.interval = stod(value);
+		}
+		else if (name == "--stop-words"sv) {
+			options.stop_words = value;
+		}
+		else if (name == "--slo-p99"sv) {
+			options.slo_p99_us = static_cast<uint32_t>(stoul(value));
+		}
+		else if (name == "--slo-p999"sv) {
+			options.slo_p999_us = static_cast<uint32_t>(stoul(value));
+		}
+		else {
+			throw invalid_argument("Unknown option "s + string(name));
+		}
+	}
+	if (options.client_count == 0 || options.interval <= 0.0 || options.rate < 0.0) {
+		throw invalid_argument("Invalid options"s);
+	}
+	return options;
+}
+
+// Разбирает журнал; строки операций ADD указывают в log_data. Некорректные строки пропускаются
+vector<Operation> ParseLog(const string& log_data, size_t& skipped_line_count) {
+	vector<Operation> operations;
+	string_view data = log_data;
+	while (!data.empty()) {
+		const size_t line_end = data.find('\n');
+		string_view line = data.substr(0, line_end);
+		data.remove_prefix(line_end == data.npos ? data.size() : line_end + 1);
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		if (line.size() < 2 || line[1] != '\t') {
+			skipped_line_count += line.empty() ? 0 : 1;
+			continue;
+		}
+		const string_view argument = line.substr(2);
+		Operation operation;
+		switch (line[0]) {
+		case 'F':
+		case 'M':
+			operation.type = line[0] == 'F' ? OperationType::FIND : OperationType::MATCH;
+			operation.query = argument;
+			break;
+		case 'A':
+			if (const auto document = ParseCorpusLine(argument)) {
+				operation.type = OperationType::ADD;
+				operation.document = *document;
+				break;
+			}
+			++skipped_line_count;
+			continue;
+		case 'R':
+			try {
+				operation.type = OperationType::REMOVE;
+				operation.document_id = stoi(string(argument));
+				break;
+			}
+			catch (const exception&) {
+				++skipped_line_count;
+				continue;
+			}
+		default:
+			++skipped_line_count;
+			continue;
+		}
+		operations.push_back(move(operation));
+	}
+	return operations;
+}
+
+uint32_t GetPercentile(const vector<uint32_t>& sorted, double percentile) {
+	if (sorted.empty()) {
+		return 0;
+	}
+	return sorted[min(sorted.size() - 1, static_cast<size_t>(percentile * sorted.size()))];
+}
+
+class Replayer {
+public:
+	Replayer(SearchServer& search_server, const vector<Operation>& operations, const ReplayOptions& options)
+		: search_server_(search_server)
+		, operations_(operations)
+		, options_(options)
+		, client_stats_(options.client_count) {
+	}
+
+	// Проигрывает журнал и возвращает статистику по интервалам
+	vector<IntervalStats> Run() {
+		start_ = steady_clock::now();
+		vector<thread> clients;
+		for (size_t i = 0; i < options_.client_count; ++i) {
+			clients.emplace_back([this, i] {
+				RunClient(client_stats_[i]);
+				});
+		}
+		for (thread& client : clients) {
+			client.join();
+		}
+		elapsed_ = duration<double>(steady_clock::now() - start_).count();
+
+		vector<IntervalStats> intervals;
+		for (const auto& stats : client_stats_) {
+			intervals.resize(max(intervals.size(), stats.size()));
+			for (size_t i = 0; i < stats.size(); ++i) {
+				intervals[i].Merge(stats[i]);
+			}
+		}
+		return intervals;
+	}
+
+	double GetElapsedSeconds() const {
+		return elapsed_;
+	}
+
+private:
+	SearchServer& search_server_;
+	const vector<Operation>& operations_;
+	const ReplayOptions& options_;
+	shared_mutex index_mutex_;
+	atomic<size_t> next_operation_ = 0;
+	steady_clock::time_point start_;
+	double elapsed_ = 0.0;
+	vector<vector<IntervalStats>> client_stats_;
+
+	void RunClient(vector<IntervalStats>& stats) {
+		// RequestQueue не потокобезопасен, у каждого клиента своя очередь
+		RequestQueue request_queue(search_server_);
+		for (size_t index = next_operation_++; index < operations_.size(); index = next_operation_++) {
+			auto arrival = steady_clock::now();
+			if (options_.rate > 0.0) {
+				arrival = start_ + duration_cast<steady_clock::duration>(duration<double>(index / options_.rate));
+				this_thread::sleep_until(arrival);
+			}
+			const Operation& operation = operations_[index];
+			bool is_query = false;
+			bool is_empty = false;
+			bool is_error = false;
+			try {
+				switch (operation.type) {
+				case OperationType::FIND: {
+					shared_lock lock(index_mutex_);
+					is_query = true;
+					is_empty = request_queue.AddFindRequest(operation.query).empty();
+					break;
+				}
+				case OperationType::MATCH: {
+					shared_lock lock(index_mutex_);
+					is_query = true;
+					is_empty = !request_queue.AddMatchRequest(operation.query);
+					break;
+				}
+				case OperationType::ADD: {
+					unique_lock lock(index_mutex_);
+					search_server_.AddDocument(operation.document.id, operation.document.text, operation.document.status,
+						operation.document.ratings);
+					break;
+				}
+				case OperationType::REMOVE: {
+					unique_lock lock(index_mutex_);
+					search_server_.RemoveDocument(operation.document_id);
+					break;
+				}
+				}
+			}
+			catch (const exception&) {
+				is_error = true;
+			}
+
+			const auto finish = steady_clock::now();
+			const size_t interval = static_cast<size_t>(duration<double>(finish - start_).count() / options_.interval);
+			if (stats.size() <= interval) {
+				stats.resize(interval + 1);
+			}
+			IntervalStats& current = stats[interval];
+			const auto latency_us = static_cast<uint32_t>(duration_cast<microseconds>(finish - arrival).count());
+			(is_query ? current.query_latencies_us : current.update_latencies_us).push_back(latency_us);
+			current.zero_result_count += is_query && is_empty && !is_error ? 1 : 0;
+			current.error_count += is_error ? 1 : 0;
+		}
+	}
+};
+
+void PrintHeader(ostream& output) {
+	output << setw(8) << "time s"s << setw(10) << "ops/s"s << setw(9) << "queries"s << setw(9) << "p50 us"s
+		<< setw(9) << "p99 us"s << setw(10) << "p999 us"s << setw(8) << "zero %"s << setw(9) << "updates"s
+		<< setw(12) << "upd p99 us"s << setw(8) << "errors"s << endl;
+}
+
+void PrintRow(ostream& output, const string& label, IntervalStats& stats, double seconds) {
+	sort(stats.query_latencies_us.begin(), stats.query_latencies_us.end());
+	sort(stats.update_latencies_us.begin(), stats.update_latencies_us.end());
+	const size_t query_count = stats.query_latencies_us.size();
+	const size_t operation_count = query_count + stats.update_latencies_us.size();
+	const double zero_result_rate = query_count > 0 ? 100.0 * stats.zero_result_count / query_count : 0.0;
+	output << setw(8) << label << setw(10) << static_cast<size_t>(operation_count / seconds) << setw(9) << query_count
+		<< setw(9) << GetPercentile(stats.query_latencies_us, 0.5)
+		<< setw(9) << GetPercentile(stats.query_latencies_us, 0.99)
+		<< setw(10) << GetPercentile(stats.query_latencies_us, 0.999)
+		<< setw(8) << fixed << setprecision(1) << zero_result_rate
+		<< setw(9) << stats.update_latencies_us.size()
+		<< setw(12) << GetPercentile(stats.update_latencies_us, 0.99)
+		<< setw(8) << stats.error_count << endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	try {
+		const ReplayOptions options = ParseOptions(argc, argv);
+
+		SearchServer search_server(options.stop_words);
+		cerr << LoadCorpus(search_server, options.corpus_path) << endl;
+
+		ifstream log_file(options.log_path, ios::binary);
+		if (!log_file) {
+			throw runtime_error("Cannot open "s + options.log_path);
+		}
+		const string log_data{ istreambuf_iterator<char>(log_file), istreambuf_iterator<char>() };
+		size_t skipped_line_count = 0;
+		const vector<Operation> operations = ParseLog(log_data, skipped_line_count);
+		cerr << operations.size() << " operations, "s << skipped_line_count << " skipped lines"s << endl;
+
+		Replayer replayer(search_server, operations, options);
+		vector<IntervalStats> intervals = replayer.Run();
+		const double elapsed = replayer.GetElapsedSeconds();
+
+		PrintHeader(cout);
+		IntervalStats total;
+		for (size_t i = 0; i < intervals.size(); ++i) {
+			total.Merge(intervals[i]);
+			// Последний интервал обычно неполный
+			const double seconds = min(options.interval, elapsed - i * options.interval);
+			ostringstream label;
+			label << fixed << setprecision(1) << (i + 1) * options.interval;
+			PrintRow(cout, label.str(), intervals[i], max(seconds, 1e-3));
+		}
+		PrintRow(cout, "total"s, total, max(elapsed, 1e-3));
+
+		const uint32_t p99 = GetPercentile(total.query_latencies_us, 0.99);
+		const uint32_t p999 = GetPercentile(total.query_latencies_us, 0.999);
+		if ((options.slo_p99_us && p99 > *options.slo_p99_us) || (options.slo_p999_us && p999 > *options.slo_p999_us)) {
+			cout << "SLO violated"s << endl;
+			return 2;
+		}
+	}
+	catch (const exception& e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+}
@@ -0,0 +1,337 @@
+#include "write_ahead_log.h"
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+#if defined(_WIN32)
+
+int OpenForAppend(const string& path) {
+	return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+bool WriteAll(int fd, string_view data) {
+	while (!data.empty()) {
+		const int written = _write(fd, data.data(), static_cast<unsigned>(min<size_t>(data.size(), 1 << 30)));
+		if (written <= 0) {
+			return false;
+		}
+		data.remove_prefix(written);
+	}
+	return true;
+}
+
+bool SyncDescriptor(int fd) {
+	return _commit(fd) == 0;
+}
+
+bool TruncateDescriptor(int fd, size_t size) {
+	return _chsize_s(fd, static_cast<long long>(size)) == 0;
+}
+
+void CloseDescriptor(int fd) {
+	_close(fd);
+}
+
+#else
+
+int OpenForAppend(const string& path) {
+	return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+bool WriteAll(int fd, string_view data) {
+	while (!data.empty()) {
+		const ssize_t written = write(fd, data.data(), data.size());
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return false;
+		}
+		data.remove_prefix(written);
+	}
+	return true;
+}
+
+bool SyncDescriptor(int fd) {
+#if defined(__linux__)
+	return fdatasync(fd) == 0;
+#else
+	return fsync(fd) == 0;
+#endif
+}
+
+bool TruncateDescriptor(int fd, size_t size) {
+	return ftruncate(fd, static_cast<off_t>(size)) == 0;
+}
+
+void CloseDescriptor(int fd) {
+	close(fd);
+}
+
+#endif
+
+// FNV-1a: журнал защищается от недописанных записей, а не от злонамеренной порчи
+uint32_t ComputeChecksum(string_view data) {
+	uint32_t hash = 2166136261u;
+	for (const char c : data) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+	}
+	return hash;
+}
+
+template <typename T>
+void PutValue(string& buffer, T value) {
+	char bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T));
+	buffer.append(bytes, sizeof(T));
+}
+
+template <typename T>
+bool GetValue(string_view& data, T& value) {
+	if (data.size() < sizeof(T)) {
+		return false;
+	}
+	memcpy(&value, data.data(), sizeof(T));
+	data.remove_prefix(sizeof(T));
+	return true;
+}
+
+bool ParsePayload(string_view payload, WalRecord& record) {
+	uint8_t type = 0;
+	int32_t document_id = 0;
+	if (!GetValue(payload, type) || !GetValue(payload, document_id)) {
+		return false;
+	}
+	record.document_id = document_id;
+	record.ratings.clear();
+	record.text = {};
+	if (type == static_cast<uint8_t>(WalRecordType::REMOVE_DOCUMENT)) {
+		record.type = WalRecordType::REMOVE_DOCUMENT;
+		return payload.empty();
+	}
+	if (type != static_cast<uint8_t>(WalRecordType::ADD_DOCUMENT)) {
+		return false;
+	}
+	record.type = WalRecordType::ADD_DOCUMENT;
+
+	uint8_t status = 0;
+	uint32_t rating_count = 0;
+	if (!GetValue(payload, status) || !GetValue(payload, rating_count) || payload.size() / sizeof(int32_t) < rating_count) {
+		return false;
+	}
+	record.status = static_cast<DocumentStatus>(status);
+	for (uint32_t i = 0; i < rating_count; ++i) {
+		int32_t rating = 0;
+		GetValue(payload, rating);
+		record.ratings.push_back(rating);
+	}
+	uint32_t text_size = 0;
+	if (!GetValue(payload, text_size) || payload.size() != text_size) {
+		return false;
+	}
+	record.text = payload;
+	return true;
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const string& path, size_t valid_size)
+	: fd_(OpenForAppend(path))
+	, path_(path) {
+	if (fd_ < 0) {
+		throw runtime_error("Cannot open log "s + path);
+	}
+	if (filesystem::file_size(path) > valid_size && !TruncateDescriptor(fd_, valid_size)) {
+		CloseDescriptor(fd_);
+		throw runtime_error("Cannot truncate log "s + path);
+	}
+	durable_size_ = valid_size;
+}
+
+WriteAheadLog::~WriteAheadLog() {
+	try {
+		Sync();
+	}
+	catch (const exception&) {
+		// Деструктор не бросает: несброшенный хвост потеряется так же, как при сбое
+	}
+	CloseDescriptor(fd_);
+}
+
+uint64_t WriteAheadLog::AppendAdd(int document_id, string_view text, DocumentStatus status, const vector<int>& ratings) {
+	lock_guard lock(mutex_);
+	CheckNotFailed();
+	const size_t record_start = buffer_.size();
+	buffer_.append(RECORD_HEADER_SIZE, '\0');
+	PutValue(buffer_, static_cast<uint8_t>(WalRecordType::ADD_DOCUMENT));
+	PutValue(buffer_, static_cast<int32_t>(document_id));
+	PutValue(buffer_, static_cast<uint8_t>(status));
+	PutValue(buffer_, static_cast<uint32_t>(ratings.size()));
+	for (const int rating : ratings) {
+		PutValue(buffer_, static_cast<int32_t>(rating));
+	}
+	PutValue(buffer_, static_cast<uint32_t>(text.size()));
+	buffer_.append(text);
+	return FinishRecord(record_start);
+}
+
+uint64_t WriteAheadLog::AppendRemove(int document_id) {
+	lock_guard lock(mutex_);
+	CheckNotFailed();
+	const size_t record_start = buffer_.size();
+	buffer_.append(RECORD_HEADER_SIZE, '\0');
+	PutValue(buffer_, static_cast<uint8_t>(WalRecordType::REMOVE_DOCUMENT));
+	PutValue(buffer_, static_cast<int32_t>(document_id));
+	return FinishRecord(record_start);
+}
+
+uint64_t WriteAheadLog::FinishRecord(size_t record_start) {
+	const string_view payload = string_view(buffer_).substr(record_start + RECORD_HEADER_SIZE);
+	const uint32_t size = static_cast<uint32_t>(payload.size());
+	const uint32_t checksum = ComputeChecksum(payload);
+	memcpy(&buffer_[record_start], &size, sizeof(size));
+	memcpy(&buffer_[record_start + sizeof(size)], &checksum, sizeof(checksum));
+	return ++appended_lsn_;
+}
+
+void WriteAheadLog::Sync(uint64_t lsn) {
+	unique_lock lock(mutex_);
+	while (durable_lsn_ < lsn) {
+		CheckNotFailed();
+		if (flushing_) {
+			synced_.wait(lock);
+			continue;
+		}
+		// Этот поток становится ведущим и сбрасывает все накопленные записи
+		flushing_ = true;
+		flush_buffer_.swap(buffer_);
+		const uint64_t target_lsn = appended_lsn_;
+		lock.unlock();
+		const bool written = WriteAll(fd_, flush_buffer_);
+		// Повторный fsync после ошибки может ложно сообщить об успехе, поэтому ошибка fsync окончательна
+		const bool synced = written && SyncDescriptor(fd_);
+		// Недописанный хвост обрезается, иначе следующие записи оказались бы за ним и пропали при восстановлении
+		const bool truncated = written || TruncateDescriptor(fd_, durable_size_);
+		lock.lock();
+		flushing_ = false;
+		if (synced) {
+			durable_lsn_ = target_lsn;
+			durable_size_ += flush_buffer_.size();
+			flush_buffer_.clear();
+		}
+		else {
+			failed_ = written || !truncated;
+			// Записи, добавленные во время сброса, идут после несброшенных
+			flush_buffer_ += buffer_;
+			buffer_.swap(flush_buffer_);
+			flush_buffer_.clear();
+		}
+		synced_.notify_all();
+		if (!synced) {
+			throw runtime_error("Cannot write log "s + path_);
+		}
+	}
+}
+
+void WriteAheadLog::Sync() {
+	uint64_t lsn = 0;
+	{
+		lock_guard lock(mutex_);
+		lsn = appended_lsn_;
+	}
+	Sync(lsn);
+}
+
+size_t WriteAheadLog::GetUnsyncedSize() const {
+	lock_guard lock(mutex_);
+	return buffer_.size();
+}
+
+void WriteAheadLog::Truncate() {
+	Sync();
+	unique_lock lock(mutex_);
+	synced_.wait(lock, [this] {
+		return !flushing_;
+		});
+	CheckNotFailed();
+	if (!TruncateDescriptor(fd_, 0) || !SyncDescriptor(fd_)) {
+		failed_ = true;
+		throw runtime_error("Cannot truncate log "s + path_);
+	}
+	durable_size_ = 0;
+}
+
+void WriteAheadLog::CheckNotFailed() const {
+	if (failed_) {
+		throw runtime_error("Log "s + path_ + " is unusable after a failed write"s);
+	}
+}
+
+WalReplayStats WriteAheadLog::Replay(const string& path, const function<void(const WalRecord&)>& handler) {
+	WalReplayStats stats;
+	if (!filesystem::exists(path)) {
+		return stats;
+	}
+	const MappedFile file(path);
+	string_view data = file.GetData();
+	WalRecord record;
+	while (data.size() >= RECORD_HEADER_SIZE) {
+		string_view header = data;
+		uint32_t size = 0;
+		uint32_t checksum = 0;
+		GetValue(header, size);
+		GetValue(header, checksum);
+		if (header.size() < size) {
+			break;
+		}
+		const string_view payload = header.substr(0, size);
+		if (ComputeChecksum(payload) != checksum || !ParsePayload(payload, record)) {
+			break;
+		}
+		handler(record);
+		++stats.record_count;
+		data.remove_prefix(RECORD_HEADER_SIZE + size);
+	}
+	stats.valid_size = file.GetData().size() - data.size();
+	stats.discarded_size = data.size();
+	return stats;
+}
+
+void SyncPath(const string& path) {
+#if defined(_WIN32)
+	// Каталоги в Windows не сбрасываются, а файл сбрасывается через _commit
+	const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+	if (fd >= 0) {
+		_commit(fd);
+		_close(fd);
+	}
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw runtime_error("Cannot open "s + path);
+	}
+	const bool synced = fsync(fd) == 0;
+	close(fd);
+	if (!synced) {
+		throw runtime_error("Cannot sync "s + path);
+	}
+#endif
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "document.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class WalRecordType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+};
+
+// Запись журнала. text указывает в буфер журнала и действителен только внутри обработчика Replay
+struct WalRecord {
+    WalRecordType type = WalRecordType::ADD_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+struct WalReplayStats {
+    size_t record_count = 0;
+    // Длина корректного начала журнала. Всё, что дальше, - недописанный при сбое хвост
+    size_t valid_size = 0;
+    size_t discarded_size = 0;
+};
+
+// Журнал изменений индекса: двоичные записи дописываются в конец файла.
+// Запись: длина данных (uint32), контрольная сумма данных (uint32), данные;
+// числа хранятся в порядке байт машины.
+// Append только кладёт запись в буфер и возвращает её номер. Sync(lsn) ждёт,
+// пока запись окажется на диске: первый пришедший поток пишет и сбрасывает
+// на диск всё накопленное, остальные ждут его, поэтому одновременные писатели
+// делят один fsync (групповая фиксация).
+// Если запись не удалась, файл обрезается до последней сброшенной записи,
+// а несброшенные записи остаются в буфере для следующего Sync. Если не удалось
+// обрезать файл или сбросить его на диск, все следующие вызовы бросают исключение.
+class WriteAheadLog {
+public:
+    // valid_size - длина корректного начала файла, найденная Replay; хвост за ней обрезается
+    WriteAheadLog(const std::string& path, size_t valid_size);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    uint64_t AppendAdd(int document_id, std::string_view text, DocumentStatus status, const std::vector<int>& ratings);
+    uint64_t AppendRemove(int document_id);
+
+    void Sync(uint64_t lsn);
+    void Sync();
+    // Объём записей, ещё не сброшенных на диск
+    size_t GetUnsyncedSize() const;
+    // Очищает журнал, например после сохранения снимка индекса
+    void Truncate();
+
+    static WalReplayStats Replay(const std::string& path, const std::function<void(const WalRecord&)>& handler);
+
+private:
+    int fd_ = -1;
+    std::string path_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable synced_;
+    std::string buffer_;
+    // Буфер, который пишет на диск текущий ведущий поток
+    std::string flush_buffer_;
+    uint64_t appended_lsn_ = 0;
+    uint64_t durable_lsn_ = 0;
+    // Длина файла, которая уже на диске: до неё файл обрезается после неудачной записи
+    size_t durable_size_ = 0;
+    bool flushing_ = false;
+    // После неудачного fsync неизвестно, что попало на диск, и журнал больше не принимает записи
+    bool failed_ = false;
+
+    void CheckNotFailed() const;
+
+    // Заполняет заголовок записи, начатой в buffer_ с позиции record_start, и выдаёт ей номер
+    uint64_t FinishRecord(size_t record_start);
+};
+
+// Сбрасывает на диск файл или каталог (на платформах, где это возможно)
+void SyncPath(const std::string& path);